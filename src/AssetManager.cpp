@@ -18,32 +18,165 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <vector>
+
 // love
 #include "common/Module.h"
+#include "modules/thread/threads.h"
+#include "modules/timer/Timer.h"
 
 // AssetManager
 #include "AssetManager.h"
 
+// Lovewrap
+#include "lovewrap/LOVEWrap.h"
+
+// Pack
+#include "pack/Pack.h"
+
+// ThreadPool
+#include "ThreadPool.h"
+
 namespace livesim
 {
 namespace asset
 {
 
-love::graphics::Image *loadImage(std::string filename)
+// Worker threads which read and decode the assets.
+static livesim::base::ThreadPool *loaderPool = nullptr;
+// Decoded assets waiting for GPU upload in main thread.
+static std::deque<std::function<void()>> uploadQueue;
+static love::thread::MutexRef uploadMutex;
+// FreeType library is shared by all rasterizers, so creating them must be serialized.
+static love::thread::MutexRef fontMutex;
+// Amount of assets which are not yet uploaded.
+static std::atomic<int> pendingCount(0);
+// Per-frame GPU upload time budget, in seconds.
+static double uploadBudget = 0.004;
+
+struct CacheEntry
+{
+	love::graphics::Image *image;
+	int64_t size;
+	uint64_t lastUse;
+};
+// Loaded images, keyed by filename and settings. Each entry holds one reference.
+static std::map<std::string, CacheEntry> imageCache;
+static love::thread::MutexRef cacheMutex;
+static uint64_t cacheTick = 0;
+static int64_t cacheSize = 0;
+static int64_t cacheBudget = 256 * 1024 * 1024;
+
+static std::string getCacheKey(const std::string &filename, const love::graphics::Image::Settings *settings)
+{
+	// Default settings depends on DPI scale at creation time, so keep it separate
+	if (settings == nullptr)
+		return filename + "\n";
+
+	char flags[64];
+	sprintf(flags, "\n%d%d%g", (int) settings->mipmaps, (int) settings->linear, settings->dpiScale);
+	return filename + flags;
+}
+
+// Evict unreferenced images, least recently used first. cacheMutex must be locked!
+static void evictCache(int64_t budget)
+{
+	if (cacheSize <= budget)
+		return;
+
+	std::vector<std::map<std::string, CacheEntry>::iterator> candidates;
+	for (auto it = imageCache.begin(); it != imageCache.end(); ++it)
+	{
+		// Only referenced by the cache
+		if (it->second.image->getReferenceCount() == 1)
+			candidates.push_back(it);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const std::map<std::string, CacheEntry>::iterator &a, const std::map<std::string, CacheEntry>::iterator &b)
+	{
+		return a->second.lastUse < b->second.lastUse;
+	});
+
+	for (auto &it: candidates)
+	{
+		if (cacheSize <= budget)
+			break;
+
+		cacheSize -= it->second.size;
+		it->second.image->release();
+		imageCache.erase(it);
+	}
+}
+
+// Get cached image. Returns retained image or nullptr if it's not in cache.
+static love::graphics::Image *getCachedImage(const std::string &key)
+{
+	love::thread::Lock lock(cacheMutex);
+
+	auto it = imageCache.find(key);
+	if (it == imageCache.end())
+		return nullptr;
+
+	it->second.lastUse = ++cacheTick;
+	it->second.image->retain();
+	return it->second.image;
+}
+
+// Put image to cache. If there's already image with same key, the passed image
+// is released and the cached one is returned instead.
+static love::graphics::Image *addCachedImage(const std::string &key, love::graphics::Image *image)
+{
+	love::thread::Lock lock(cacheMutex);
+
+	auto it = imageCache.find(key);
+	if (it != imageCache.end())
+	{
+		image->release();
+		it->second.lastUse = ++cacheTick;
+		it->second.image->retain();
+		return it->second.image;
+	}
+
+	CacheEntry entry;
+	entry.image = image;
+	entry.size = image->getGraphicsMemorySize();
+	entry.lastUse = ++cacheTick;
+
+	// This reference belongs to the cache
+	image->retain();
+	imageCache[key] = entry;
+	cacheSize += entry.size;
+
+	evictCache(cacheBudget);
+	return image;
+}
+
+love::graphics::Image *loadImage(std::string filename, const love::graphics::Image::Settings *settings)
 {
 	auto lfs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
 	
 	// Create new File object
 	auto file = lfs->newFile(filename.c_str());
-	auto out = loadImage(file);
+	auto out = loadImage(file, settings);
 	
 	file->release();
 	return out;
 }
-love::graphics::Image *loadImage(love::filesystem::File *filename)
+love::graphics::Image *loadImage(love::filesystem::File *filename, const love::graphics::Image::Settings *settings)
 {
 	auto li = love::Module::getInstance<love::image::Image>(love::Module::M_IMAGE);
-	auto lg = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
+
+	// Look at cache first
+	std::string key = getCacheKey(filename->getFilename(), settings);
+	love::graphics::Image *image = getCachedImage(key);
+	if (image)
+		return image;
 
 	// Open file
 	if (!filename->isOpen())
@@ -57,15 +190,11 @@ love::graphics::Image *loadImage(love::filesystem::File *filename)
 
 	// Load ImageData
 	love::filesystem::FileData *imagedata = filename->read();
-	love::graphics::Image *image = nullptr;
-	love::graphics::Image::Flags flg;
-	flg.linear = false;
-	flg.mipmaps = false;
 	try
 	{
 		// Try CompressedImageData first
 		love::image::CompressedImageData *cid_real = li->newCompressedData(imagedata);
-		image = lg->newImage(std::vector<decltype(cid_real)>({cid_real}), flg);
+		image = lovewrap::graphics::newImage(cid_real, settings);
 		cid_real->release();
 	}
 	catch (love::Exception &)
@@ -74,17 +203,21 @@ love::graphics::Image *loadImage(love::filesystem::File *filename)
 		{
 			// Now try ImageData
 			love::image::ImageData *id_real = li->newImageData(imagedata);
-			image = lg->newImage(std::vector<decltype(id_real)>({id_real}), flg);
+			image = lovewrap::graphics::newImage(id_real, settings);
 			id_real->release();
 		}
 		catch (love::Exception &) {}
 	}
 	
 	imagedata->release();
+
+	if (image)
+		image = addCachedImage(key, image);
+
 	return image;
 }
 
-love::graphics::opengl::Font *loadFont(std::string filename, int size)
+love::graphics::Font *loadFont(std::string filename, int size)
 {
 	auto lfs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
 
@@ -96,7 +229,7 @@ love::graphics::opengl::Font *loadFont(std::string filename, int size)
 	return out;
 }
 
-love::graphics::opengl::Font *loadFont(love::filesystem::File *filename, int size)
+love::graphics::Font *loadFont(love::filesystem::File *filename, int size)
 {
 	// If filename is nullptr, then use Vera sans variant
 	if (filename == nullptr)
@@ -121,6 +254,7 @@ love::graphics::opengl::Font *loadFont(love::filesystem::File *filename, int siz
 	// Create TrueTypeRasterizer
 	try
 	{
+		love::thread::Lock lock(fontMutex);
 		rast = lf->newTrueTypeRasterizer(fd, size, love::font::TrueTypeRasterizer::HINTING_NORMAL);
 		fd->release();
 	}
@@ -130,25 +264,274 @@ love::graphics::opengl::Font *loadFont(love::filesystem::File *filename, int siz
 	}
 	
 	// Create new Font object
-	auto lg = love::Module::getInstance<love::graphics::opengl::Graphics>(love::Module::M_GRAPHICS);
+	auto lg = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
 	auto out = lg->newFont(rast);
 	rast->release();
 
 	return out;
 }
 
-love::graphics::opengl::Font *loadFont(int size)
+love::graphics::Font *loadFont(int size)
 {
 	auto lf = love::Module::getInstance<love::font::Font>(love::Module::M_FONT);
-	auto lg = love::Module::getInstance<love::graphics::opengl::Graphics>(love::Module::M_GRAPHICS);
+	auto lg = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
 
 	// Load Vera sans rasterizer
-	love::font::Rasterizer *rast = lf->newTrueTypeRasterizer(size, love::font::TrueTypeRasterizer::HINTING_NORMAL);
+	love::font::Rasterizer *rast = nullptr;
+	{
+		love::thread::Lock lock(fontMutex);
+		rast = lf->newTrueTypeRasterizer(size, love::font::TrueTypeRasterizer::HINTING_NORMAL);
+	}
 	auto out = lg->newFont(rast);
 	rast->release();
 
 	return out;
 }
 
+void initialize(int threads)
+{
+	if (loaderPool == nullptr)
+		loaderPool = new livesim::base::ThreadPool(threads, "livesim4 asset loader");
+}
+
+void deinitialize()
+{
+	// Wait for running jobs
+	delete loaderPool;
+	loaderPool = nullptr;
+
+	{
+		love::thread::Lock lock(uploadMutex);
+		uploadQueue.clear();
+		pendingCount = 0;
+	}
+
+	// Drop all cache references
+	love::thread::Lock lock(cacheMutex);
+	for (auto &i: imageCache)
+		i.second.image->release();
+
+	imageCache.clear();
+	cacheSize = 0;
+}
+
+// Queue function to be run by main thread in update()
+static void queueUpload(const std::function<void()> &func)
+{
+	love::thread::Lock lock(uploadMutex);
+	uploadQueue.push_back(func);
+}
+
+// Read whole file. Returns nullptr on failure.
+static love::Data *readFile(const std::string &filename)
+{
+	auto lfs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+
+	// Stored file in asset pack can be used without copying
+	love::Data *mapped = livesim::pack::getMappedData(filename);
+	if (mapped)
+		return mapped;
+
+	try
+	{
+		return lfs->read(filename.c_str());
+	}
+	catch (love::Exception &)
+	{
+		return nullptr;
+	}
+}
+
+void update(double budget)
+{
+	if (budget < 0.0)
+		budget = uploadBudget;
+
+	double start = love::timer::Timer::getTime();
+
+	for (;;)
+	{
+		std::function<void()> func;
+
+		{
+			love::thread::Lock lock(uploadMutex);
+			if (uploadQueue.empty())
+				break;
+
+			func = std::move(uploadQueue.front());
+			uploadQueue.pop_front();
+		}
+
+		func();
+		pendingCount--;
+
+		if (love::timer::Timer::getTime() - start >= budget)
+			break;
+	}
+
+	// Images may have been released since last frame
+	love::thread::Lock lock(cacheMutex);
+	evictCache(cacheBudget);
+}
+
+void setUploadBudget(double budget)
+{
+	uploadBudget = budget;
+}
+
+int getPendingCount()
+{
+	return pendingCount;
+}
+
+void setCacheBudget(int64_t bytes)
+{
+	love::thread::Lock lock(cacheMutex);
+	cacheBudget = bytes;
+	evictCache(cacheBudget);
+}
+
+int64_t getCacheBudget()
+{
+	return cacheBudget;
+}
+
+int64_t getCacheSize()
+{
+	love::thread::Lock lock(cacheMutex);
+	return cacheSize;
+}
+
+void clearCache()
+{
+	love::thread::Lock lock(cacheMutex);
+	evictCache(0);
+}
+
+AsyncImage *loadImageAsync(const std::string &filename, const love::graphics::Image::Settings *settings)
+{
+	initialize();
+
+	AsyncImage *handle = new AsyncImage();
+	std::string key = getCacheKey(filename, settings);
+
+	// Already loaded
+	love::graphics::Image *cached = getCachedImage(key);
+	if (cached)
+	{
+		handle->setAsset(cached);
+		return handle;
+	}
+
+	love::StrongRef<AsyncImage> ref(handle);
+	bool hasSettings = settings != nullptr;
+	love::graphics::Image::Settings s;
+	if (hasSettings)
+		s = *settings;
+
+	pendingCount++;
+	loaderPool->submit([ref, filename, key, hasSettings, s]()
+	{
+		auto li = love::Module::getInstance<love::image::Image>(love::Module::M_IMAGE);
+		love::StrongRef<love::image::CompressedImageData> cid;
+		love::StrongRef<love::image::ImageData> id;
+
+		// Nobody else wants this, skip decoding.
+		if (ref->getReferenceCount() > 1)
+		{
+			love::StrongRef<love::Data> fd(readFile(filename), love::Acquire::NORETAIN);
+
+			if (fd)
+			{
+				try
+				{
+					// Try CompressedImageData first
+					cid.set(li->newCompressedData(fd), love::Acquire::NORETAIN);
+				}
+				catch (love::Exception &)
+				{
+					try
+					{
+						// Now try ImageData
+						id.set(li->newImageData(fd), love::Acquire::NORETAIN);
+					}
+					catch (love::Exception &) {}
+				}
+			}
+		}
+
+		queueUpload([ref, cid, id, key, hasSettings, s]()
+		{
+			love::graphics::Image *image = nullptr;
+			const love::graphics::Image::Settings *settings = hasSettings ? &s : nullptr;
+
+			try
+			{
+				if (ref->getReferenceCount() == 1)
+					// Handle is no longer referenced, don't waste GPU time.
+					image = nullptr;
+				else if (cid)
+					image = lovewrap::graphics::newImage(cid, settings);
+				else if (id)
+					image = lovewrap::graphics::newImage(id, settings);
+			}
+			catch (love::Exception &) {}
+
+			if (image)
+				image = addCachedImage(key, image);
+
+			ref->setAsset(image);
+		});
+	});
+
+	return handle;
+}
+
+AsyncFont *loadFontAsync(const std::string &filename, int size)
+{
+	initialize();
+
+	AsyncFont *handle = new AsyncFont();
+	love::StrongRef<AsyncFont> ref(handle);
+
+	pendingCount++;
+	loaderPool->submit([ref, filename, size]()
+	{
+		auto lf = love::Module::getInstance<love::font::Font>(love::Module::M_FONT);
+		love::StrongRef<love::font::Rasterizer> rast;
+
+		if (ref->getReferenceCount() > 1)
+		{
+			love::StrongRef<love::Data> fd(readFile(filename), love::Acquire::NORETAIN);
+
+			if (fd)
+			{
+				try
+				{
+					love::thread::Lock lock(fontMutex);
+					rast.set(lf->newTrueTypeRasterizer(fd, size, love::font::TrueTypeRasterizer::HINTING_NORMAL), love::Acquire::NORETAIN);
+				}
+				catch (love::Exception &) {}
+			}
+		}
+
+		queueUpload([ref, rast]()
+		{
+			love::graphics::Font *font = nullptr;
+
+			try
+			{
+				if (rast && ref->getReferenceCount() > 1)
+					font = lovewrap::graphics::newFont(rast);
+			}
+			catch (love::Exception &) {}
+
+			ref->setAsset(font);
+		});
+	});
+
+	return handle;
+}
+
 } // asset
 } // livesim
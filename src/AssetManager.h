@@ -22,10 +22,12 @@
 #define LIVESIM_ASSETMANAGER_H
 
 // std
+#include <cstdint>
 #include <map>
 #include <string>
 
 // love
+#include "common/Object.h"
 #include "modules/filesystem/Filesystem.h"
 #include "modules/filesystem/physfs/Filesystem.h"
 #include "modules/font/Font.h"
@@ -41,17 +43,22 @@ namespace asset
 /**
  * Load image (string filename). User must release the Image!
  *
+ * Images are cached by filename and settings, so loading same image
+ * twice returns the same object.
+ *
  * @param filename Image filename
+ * @param settings Image settings (or nullptr for default)
  * @return Drawable image object (or nullptr on failure)
  */
-love::graphics::Image *loadImage(std::string filename);
+love::graphics::Image *loadImage(std::string filename, const love::graphics::Image::Settings *settings = nullptr);
 /**
  * Load image (File object). User must release the Image!
  *
  * @param filename Image filename
+ * @param settings Image settings (or nullptr for default)
  * @return Drawable image object (or nullptr on failure)
  */
-love::graphics::Image *loadImage(love::filesystem::File *filename);
+love::graphics::Image *loadImage(love::filesystem::File *filename, const love::graphics::Image::Settings *settings = nullptr);
 /**
  * Load font (string filename). User must release the Font!
  *
@@ -76,6 +83,129 @@ love::graphics::Font *loadFont(love::filesystem::File *filename, int size = 12);
  */
 love::graphics::Font *loadFont(int size = 12);
 
+/* State of asynchronously loaded asset */
+enum AsyncState
+{
+	ASYNC_PENDING,
+	ASYNC_READY,
+	ASYNC_FAILED
+};
+
+/**
+ * Handle to asynchronously loaded asset. The file read and decoding is done
+ * in worker thread, while the GPU object creation is done in main thread
+ * inside livesim::asset::update.
+ */
+template<typename T>
+class AsyncAsset: public love::Object
+{
+public:
+	AsyncAsset(): state(ASYNC_PENDING), asset(nullptr) {}
+	virtual ~AsyncAsset()
+	{
+		if (asset)
+			asset->release();
+	}
+	/**
+	 * Get loading state.
+	 *
+	 * @return Current loading state.
+	 */
+	AsyncState getState() const { return state; }
+	/* Is the asset ready to use? */
+	bool isReady() const { return state == ASYNC_READY; }
+	/* Is the loading finished (either success or failure)? */
+	bool isDone() const { return state != ASYNC_PENDING; }
+	/**
+	 * Get the loaded asset. The object is owned by this handle, retain it
+	 * if it's needed beyond the lifetime of the handle.
+	 *
+	 * @return Loaded asset or nullptr if it's not ready yet or failed.
+	 */
+	T *get() const { return asset; }
+
+	/* Set loaded asset. Takes ownership of the object. Should not be called directly! */
+	void setAsset(T *obj)
+	{
+		asset = obj;
+		state = obj ? ASYNC_READY : ASYNC_FAILED;
+	}
+
+private:
+	AsyncState state;
+	T *asset;
+};
+
+typedef AsyncAsset<love::graphics::Image> AsyncImage;
+typedef AsyncAsset<love::graphics::Font> AsyncFont;
+
+/**
+ * Initialize asynchronous asset loader.
+ *
+ * @param threads Amount of worker threads. 0 means use default based on CPU count.
+ */
+void initialize(int threads = 0);
+/* Stop asynchronous asset loader. Pending uploads are discarded. */
+void deinitialize();
+/**
+ * Upload decoded assets to GPU. Must be called from main thread once per frame.
+ * At least one pending asset is uploaded regardless of the time budget.
+ *
+ * @param budget Maximum time spent in seconds, or negative to use budget set by setUploadBudget.
+ */
+void update(double budget = -1.0);
+/**
+ * Set per-frame time budget used for GPU upload.
+ *
+ * @param budget Time budget in seconds.
+ */
+void setUploadBudget(double budget);
+/**
+ * Get amount of assets which are still loading.
+ *
+ * @return Amount of pending assets.
+ */
+int getPendingCount();
+
+/**
+ * Set image cache VRAM budget. Unreferenced images are evicted,
+ * least recently used first, when the budget is exceeded.
+ *
+ * @param bytes Budget in bytes.
+ */
+void setCacheBudget(int64_t bytes);
+/**
+ * Get image cache VRAM budget.
+ *
+ * @return Budget in bytes.
+ */
+int64_t getCacheBudget();
+/**
+ * Get VRAM used by all images in cache, including referenced ones.
+ *
+ * @return Used VRAM in bytes.
+ */
+int64_t getCacheSize();
+/* Release all cached images which are not referenced elsewhere. */
+void clearCache();
+
+/**
+ * Load image asynchronously. User must release the handle!
+ *
+ * @param filename Image filename
+ * @param settings Image settings (or nullptr for default)
+ * @return Handle to the image.
+ */
+AsyncImage *loadImageAsync(const std::string &filename, const love::graphics::Image::Settings *settings = nullptr);
+/**
+ * Load font asynchronously. User must release the handle!
+ *
+ * @param filename Font filename
+ * @param size Font size
+ * @return Handle to the font.
+ */
+AsyncFont *loadFontAsync(const std::string &filename, int size = 12);
+
 } // asset
 } // livesim
 
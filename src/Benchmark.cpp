@@ -0,0 +1,355 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// Headless benchmark. Only compiled with LIVESIM_BENCHMARK defined,
+// in which case this provides main() instead of livesim4.cpp.
+// There's no null graphics backend, so draw calls are only measured
+// with --graphics, which needs a real window.
+#ifdef LIVESIM_BENCHMARK
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <string>
+#include <vector>
+
+extern "C" {
+// Lua
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+
+// libav
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+// PhysFS
+#include "libraries/physfs/physfs.h"
+
+// love
+#include "common/Module.h"
+#include "modules/audio/null/Audio.h"
+#include "modules/love/love.h"
+#include "modules/timer/Timer.h"
+
+// lvep
+extern "C" int luaopen_lvep(lua_State *L);
+
+// Asset manager
+#include "AssetManager.h"
+
+// Boot
+#include "Boot.h"
+
+// Main loop
+#include "MainLoop.h"
+
+// Profiler
+#include "Profiler.h"
+
+// Scene
+#include "Scene.h"
+
+// Allocation counter. Counts every operator new in the process.
+static std::atomic<uint64_t> allocationCount(0);
+
+void *operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void *ptr = malloc(size > 0 ? size : 1);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw()
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &t) throw()
+{
+	return operator new(size, t);
+}
+
+void operator delete(void *ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) throw()
+{
+	free(ptr);
+}
+
+// Configuration from conf.cpp
+extern GameConfiguration conf;
+
+struct BenchmarkOptions
+{
+	std::string scene;
+	int frames;
+	double fps;
+	double tickRate;
+	bool graphics;
+	std::string csv;
+};
+
+static void printUsage(const char *exe)
+{
+	fprintf(stderr,
+		"Usage: %s [options] <scene>\n"
+		"Options:\n"
+		"  --frames <n>    Amount of frames to run (default 1000)\n"
+		"  --fps <n>       Synthetic frame rate (default 60)\n"
+		"  --tickrate <n>  Scene::tick rate (default main loop setting)\n"
+		"  --graphics      Create window and graphics to measure draw calls\n"
+		"  --csv <file>    Dump last frames as CSV to save directory\n"
+		"Scenes:\n",
+		exe
+	);
+
+	for (const std::string &name: livesim::base::getSceneNames())
+		fprintf(stderr, "  %s\n", name.c_str());
+}
+
+static bool parseOptions(int argc, char *argv[], BenchmarkOptions &opts)
+{
+	opts.frames = 1000;
+	opts.fps = 60.0;
+	opts.tickRate = livesim::base::getTickRate();
+	opts.graphics = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--frames" && hasValue)
+			opts.frames = atoi(argv[++i]);
+		else if (arg == "--fps" && hasValue)
+			opts.fps = atof(argv[++i]);
+		else if (arg == "--tickrate" && hasValue)
+			opts.tickRate = atof(argv[++i]);
+		else if (arg == "--csv" && hasValue)
+			opts.csv = argv[++i];
+		else if (arg == "--graphics")
+			opts.graphics = true;
+		else if (arg.compare(0, 2, "--") == 0)
+			return false;
+		else
+			opts.scene = arg;
+	}
+
+	return !opts.scene.empty() && opts.frames > 0 && opts.fps > 0.0;
+}
+
+// Nearest-rank percentile of sorted values.
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	size_t index = (size_t) (p / 100.0 * (double) (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static int runBenchmark(const BenchmarkOptions &opts)
+{
+	using namespace livesim;
+
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+
+	lua_getglobal(L, "package");
+	lua_getfield(L, -1, "preload");
+	lua_pushcfunction(L, &luaopen_love);
+	lua_setfield(L, -2, "love");
+	lua_pushcfunction(L, &luaopen_lvep);
+	lua_setfield(L, -2, "lvep");
+	lua_pop(L, 2);
+
+	lua_getglobal(L, "require");
+	lua_pushstring(L, "love");
+	lua_call(L, 1, 0);
+
+	// Register null audio so love.audio picks it instead of OpenAL
+	love::audio::null::Audio *audio = new love::audio::null::Audio();
+	love::Module::registerInstance(audio);
+
+	// Same modules as the game, minus window and graphics when headless
+	GameConfiguration benchConf = conf;
+	if (!opts.graphics)
+	{
+		static const char *const headless[] = {"window", "graphics", "video"};
+		benchConf.window = nullptr;
+
+		for (const char *name: headless)
+		{
+			benchConf.modules.erase(std::remove(benchConf.modules.begin(), benchConf.modules.end(), std::string(name)), benchConf.modules.end());
+			benchConf.lazymodules.erase(std::remove(benchConf.lazymodules.begin(), benchConf.lazymodules.end(), std::string(name)), benchConf.lazymodules.end());
+		}
+	}
+
+	bootLivesim4(L, benchConf);
+
+	base::initializeScene();
+	asset::initialize();
+
+	base::Scene *scene = base::newScene(opts.scene);
+	if (scene == nullptr)
+	{
+		fprintf(stderr, "No such scene: %s\n", opts.scene.c_str());
+		base::freeScene();
+		asset::deinitialize();
+		freeBoot();
+		lua_close(L);
+		audio->release();
+		return 1;
+	}
+
+	base::loadScene(scene);
+	base::swapScene();
+	base::setTickRate(opts.tickRate);
+	profiler::setEnabled(true);
+
+	std::vector<double> frameTimes(opts.frames);
+	std::vector<uint64_t> frameAllocs(opts.frames);
+	int64_t drawCalls = 0, drawCallsBatched = 0, shaderSwitches = 0;
+	double dt = 1.0 / opts.fps;
+
+	for (int i = 0; i < opts.frames; i++)
+	{
+		uint64_t allocs = allocationCount.load(std::memory_order_relaxed);
+		double start = love::timer::Timer::getTime();
+
+		profiler::beginFrame();
+		base::stepFrame(dt);
+		profiler::endFrame();
+
+		frameTimes[i] = love::timer::Timer::getTime() - start;
+		frameAllocs[i] = allocationCount.load(std::memory_order_relaxed) - allocs;
+
+		profiler::Frame f;
+		if (profiler::getLastFrame(f))
+		{
+			drawCalls += f.drawCalls;
+			drawCallsBatched += f.drawCallsBatched;
+			shaderSwitches += f.shaderSwitches;
+		}
+	}
+
+	if (!opts.csv.empty())
+		profiler::dumpCSV(opts.csv);
+
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	uint64_t totalAllocs = 0;
+	for (int i = 0; i < opts.frames; i++)
+	{
+		total += frameTimes[i];
+		totalAllocs += frameAllocs[i];
+	}
+
+	printf("scene: %s\n", opts.scene.c_str());
+	printf("frames: %d at %g fps, tick rate %g\n", opts.frames, opts.fps, opts.tickRate);
+	printf("frame time (ms): min %.4f mean %.4f p50 %.4f p90 %.4f p99 %.4f max %.4f\n",
+		sorted.front() * 1000.0,
+		total / opts.frames * 1000.0,
+		percentile(sorted, 50.0) * 1000.0,
+		percentile(sorted, 90.0) * 1000.0,
+		percentile(sorted, 99.0) * 1000.0,
+		sorted.back() * 1000.0
+	);
+	printf("allocations: %llu total, %.2f per frame, %llu max\n",
+		(unsigned long long) totalAllocs,
+		(double) totalAllocs / opts.frames,
+		(unsigned long long) *std::max_element(frameAllocs.begin(), frameAllocs.end())
+	);
+
+	if (opts.graphics)
+		printf("draw calls per frame: %.2f (%.2f batched), shader switches %.2f\n",
+			(double) drawCalls / opts.frames,
+			(double) drawCallsBatched / opts.frames,
+			(double) shaderSwitches / opts.frames
+		);
+
+	printf("module load times:\n");
+	printBootReport();
+
+	profiler::setEnabled(false);
+	base::freeScene();
+	asset::deinitialize();
+	freeBoot();
+	lua_close(L);
+	audio->release();
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkOptions opts;
+
+	if (!parseOptions(argc, argv, opts))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	PHYSFS_init(argv[0]);
+	av_register_all();
+	avcodec_register_all();
+
+	try
+	{
+		return runBenchmark(opts);
+	}
+	catch (std::exception &e)
+	{
+		fprintf(stderr, "Exception: %s\n", e.what());
+		return 1;
+	}
+}
+
+#endif // LIVESIM_BENCHMARK
@@ -20,6 +20,8 @@
 
 // STL
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <map>
 #include <string>
 
@@ -30,10 +32,14 @@
 
 // SDL
 #include <SDL_hints.h>
+#include <SDL_thread.h>
 
 // LOVEWrap
 #include "lovewrap/LOVEWrap.h"
 
+// Pack
+#include "pack/Pack.h"
+
 // List of LOVE modules
 extern "C" {
 int luaopen_love_data(lua_State *L);
@@ -82,13 +88,110 @@ extern "C" int luaopen_love_filesystem(lua_State *L);
 // Contains the game configuration, declared in conf.cpp
 extern GameConfiguration conf;
 
+// Module name for love::Module::ModuleType
+static const char *moduleTypeNames[love::Module::M_MAX_ENUM] = {
+	"audio", "data", "event", "filesystem", "font", "graphics", "image",
+	"joystick", "keyboard", "math", "mouse", "physics", "sound", "system",
+	"thread", "timer", "touch", "video", "window"
+};
+
+// Lua state used to load lazy modules
+static lua_State *bootState = nullptr;
+// Lazy modules can only be loaded from this thread
+static SDL_threadID bootThread = 0;
+// Lazy modules which are not loaded yet. Read by getInstance in any thread.
+static std::atomic<bool> lazyPending[love::Module::M_MAX_ENUM];
+// Lazy modules which were asked for outside boot thread, to report once
+static std::atomic<bool> lazyMisused[love::Module::M_MAX_ENUM];
+static std::vector<ModuleLoadTime> moduleLoadTimes;
+
+static int loadModule(lua_State *L, const std::string &name, bool lazy)
+{
+	double start = love::timer::Timer::getTime();
+
+	lua_pushcfunction(L, loveModules[name]);
+	lua_pushfstring(L, "love.%s", name.c_str());
+	int status = 0;
+
+	if (lazy)
+		status = lua_pcall(L, 1, 0, 0);
+	else
+		lua_call(L, 1, 0);
+
+	ModuleLoadTime t = {name, love::timer::Timer::getTime() - start, lazy};
+	moduleLoadTimes.push_back(t);
+
+	return status;
+}
+
+static void loadLazyModule(love::Module::ModuleType type)
+{
+	if (!lazyPending[type])
+		return;
+
+	if (SDL_ThreadID() != bootThread)
+	{
+		// Caller gets nullptr. Such module must be in the eager list.
+		if (!lazyMisused[type].exchange(true))
+			fprintf(stderr, "love.%s is lazily loaded, but requested outside boot thread\n", moduleTypeNames[type]);
+
+		return;
+	}
+
+	if (bootState == nullptr)
+		return;
+
+	// Never try again, even if it fails. This also prevents recursion.
+	lazyPending[type] = false;
+
+	if (loadModule(bootState, moduleTypeNames[type], true))
+	{
+		fprintf(stderr, "Cannot load love.%s: %s\n", moduleTypeNames[type], lua_tostring(bootState, -1));
+		lua_pop(bootState, 1);
+	}
+}
+
 void bootLivesim4(lua_State *L)
 {
+	bootLivesim4(L, conf);
+}
+
+void freeBoot()
+{
+	love::Module::setLoadHook(nullptr);
+	bootState = nullptr;
+}
+
+const std::vector<ModuleLoadTime> &getModuleLoadTimes()
+{
+	return moduleLoadTimes;
+}
+
+void printBootReport()
+{
+	double total = 0.0;
+
+	for (const ModuleLoadTime &t: moduleLoadTimes)
+	{
+		printf("love.%-12s %8.3fms%s\n", t.name.c_str(), t.time * 1000.0, t.lazy ? " (lazy)" : "");
+		total += t.time;
+	}
+
+	printf("total %17.3fms\n", total * 1000.0);
+}
+
+void bootLivesim4(lua_State *L, const GameConfiguration &conf)
+{
+	moduleLoadTimes.clear();
+
 	// Require love.filesystem
 	lua_pushcfunction(L, luaopen_love_filesystem);
 	lua_pushstring(L, "love.filesystem");
 	lua_call(L, 1, 0);
 
+	// Fused executable can have asset pack appended instead of zip
+	livesim::pack::registerArchiver();
+
 	// Set source
 	std::string exePath = lovewrap::filesystem::getExecutablePath();
 	bool canHasGame = lovewrap::filesystem::setSource(exePath);
@@ -104,23 +207,33 @@ void bootLivesim4(lua_State *L)
 	love::graphics::setGammaCorrect(conf.gammacorrect);
 
 	// Load desired modules
-	for (std::string i : conf.modules)
+	for (const std::string &i : conf.modules)
 	{
 		// Is valid module name?
 		if (loveModules.count(i))
-		{
-			lua_pushcfunction(L, loveModules[i]);
-			lua_pushfstring(L, "love.%s", i.c_str());
-			lua_call(L, 1, 0);
-		}
+			loadModule(L, i, false);
 	}
 
+	// The rest is loaded on first love::Module::getInstance
+	for (int i = 0; i < love::Module::M_MAX_ENUM; i++)
+	{
+		const std::string name = moduleTypeNames[i];
+		lazyMisused[i] = false;
+		lazyPending[i] = loveModules.count(name) > 0 &&
+			std::find(conf.lazymodules.begin(), conf.lazymodules.end(), name) != conf.lazymodules.end() &&
+			std::find(conf.modules.begin(), conf.modules.end(), name) == conf.modules.end();
+	}
+
+	bootState = L;
+	bootThread = SDL_ThreadID();
+	love::Module::setLoadHook(&loadLazyModule);
+
 	// Setup window
 	if (conf.window != nullptr && std::find(conf.modules.begin(), conf.modules.end(), std::string("window")) != conf.modules.end())
 	{
 		// The casting is assumed to be valid, unless LOVE add some alignment in the
 		// love::window::WindowSettings struct.
-		bool set = lovewrap::window::setMode(conf.window->width, conf.window->height, (love::window::WindowSettings *)&conf.window);
+		bool set = lovewrap::window::setMode(conf.window->width, conf.window->height, (love::window::WindowSettings *)conf.window);
 		if (!set)
 			throw love::Exception("Could not set window mode");
 
@@ -131,7 +244,7 @@ void bootLivesim4(lua_State *L)
 		}
 	}
 
-	if (lovewrap::isModuleLoaded("timer"))
+	if (love::Module::getInstance<love::timer::Timer>(love::Module::M_TIMER))
 		// first timestep, because window creation can take some time
 		lovewrap::timer::step();
 	// love.filesystem thing, set identity and save
@@ -18,6 +18,9 @@
 * 3. This notice may not be removed or altered from any source distribution.
 */
 
+#ifndef LIVESIM_BOOT_H
+#define LIVESIM_BOOT_H
+
 // STL
 #include <string>
 #include <vector>
@@ -76,6 +79,55 @@ struct GameConfiguration
 	// any function from love.graphics is called before the first love::window::setMode in
 	// your code.
 	GameWindowSettings *window;
-	// List of needed modules.
+	// List of needed modules, loaded at boot.
 	std::vector<std::string> modules;
+	// List of modules loaded on first use (love::Module::getInstance) instead of at boot.
+	// Only loaded from main thread, so modules used by worker threads must be in "modules".
+	std::vector<std::string> lazymodules;
+};
+
+/// Time taken to load a LOVE module.
+struct ModuleLoadTime
+{
+	// Module name, without "love." prefix.
+	std::string name;
+	// Time taken, in seconds.
+	double time;
+	// Loaded on first use?
+	bool lazy;
 };
+
+struct lua_State;
+
+/**
+ * Load LOVE modules listed in conf, setup window and filesystem identity.
+ * This replaces love.boot, so main.lua and conf.lua are never loaded.
+ *
+ * @param L Lua state where "love" is already required.
+ */
+void bootLivesim4(lua_State *L);
+/**
+ * Same as above, but using specified configuration instead of the one
+ * from conf.cpp.
+ *
+ * @param L Lua state where "love" is already required.
+ * @param config Game configuration to use.
+ */
+void bootLivesim4(lua_State *L, const GameConfiguration &config);
+/**
+ * Stop loading modules on demand. Must be called before the Lua state
+ * passed to bootLivesim4 is closed.
+ */
+void freeBoot();
+/**
+ * Get load time of every loaded LOVE module, in load order.
+ *
+ * @return List of module load times.
+ */
+const std::vector<ModuleLoadTime> &getModuleLoadTimes();
+/**
+ * Print module load times to stdout.
+ */
+void printBootReport();
+
+#endif
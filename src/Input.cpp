@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <deque>
+
+// Input
+#include "Input.h"
+
+namespace livesim
+{
+namespace base
+{
+
+// Only accessed from main thread.
+static std::deque<InputEvent> inputQueue;
+
+void pushInput(const InputEvent &e)
+{
+	inputQueue.push_back(e);
+
+	// SDL timestamps have millisecond resolution and are converted relative
+	// to poll time, so keep the queue ordered.
+	InputEvent &back = inputQueue.back();
+	if (inputQueue.size() > 1 && back.time < inputQueue[inputQueue.size() - 2].time)
+		back.time = inputQueue[inputQueue.size() - 2].time;
+}
+
+bool pollInput(InputEvent &e, double until)
+{
+	if (inputQueue.empty() || inputQueue.front().time > until)
+		return false;
+
+	e = inputQueue.front();
+	inputQueue.pop_front();
+	return true;
+}
+
+size_t getInputCount()
+{
+	return inputQueue.size();
+}
+
+void discardInput(double until)
+{
+	while (!inputQueue.empty() && inputQueue.front().time <= until)
+		inputQueue.pop_front();
+}
+
+void clearInput()
+{
+	inputQueue.clear();
+}
+
+} // base
+} // livesim
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_INPUT_H
+#define LIVESIM_INPUT_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+// love
+#include "modules/keyboard/Keyboard.h"
+
+namespace livesim
+{
+namespace base
+{
+
+/* Timestamped input event */
+struct InputEvent
+{
+	enum Type
+	{
+		KEY_PRESSED,
+		KEY_RELEASED,
+		MOUSE_PRESSED,
+		MOUSE_RELEASED,
+		MOUSE_MOVED,
+		TOUCH_PRESSED,
+		TOUCH_RELEASED,
+		TOUCH_MOVED
+	};
+
+	Type type;
+	// When the event happened, in love.timer clock (love::timer::Timer::getTime).
+	// Desktop input only has the time it was polled, see pollEvents.
+	double time;
+
+	// Keyboard events
+	love::keyboard::Keyboard::Key key;
+	love::keyboard::Keyboard::Scancode scancode;
+	bool repeat;
+
+	// Mouse and touch events, in DPI-scaled units.
+	double x, y;
+	double dx, dy;
+	// Mouse button. 1 is primary, 2 is secondary, 3 is middle.
+	int32_t button;
+	// Mouse event originated from touchscreen?
+	bool istouch;
+
+	// Touch events
+	int64_t id;
+	double pressure;
+};
+
+/**
+ * Add event to the input queue. Used by main loop.
+ *
+ * @param e The event. Its time must not be older than previously pushed event.
+ */
+void pushInput(const InputEvent &e);
+/**
+ * Take oldest event which happened at or before specified time.
+ * Call this from Scene::tick with getTickTime() to process input
+ * at simulation-tick granularity.
+ *
+ * @param e Where the event is copied to.
+ * @param until Time limit, in love.timer clock.
+ * @return true if an event is taken, false if there's none.
+ */
+bool pollInput(InputEvent &e, double until);
+/**
+ * Get amount of events in the input queue.
+ *
+ * @return Queued event count.
+ */
+size_t getInputCount();
+/**
+ * Discard events which happened at or before specified time.
+ * The main loop does this after ticking, so unread events don't pile up.
+ *
+ * @param until Time limit, in love.timer clock.
+ */
+void discardInput(double until);
+/* Discard all queued events. */
+void clearInput();
+
+} // base
+} // livesim
+
+#endif
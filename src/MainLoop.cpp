@@ -0,0 +1,518 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// SDL
+#include <SDL_events.h>
+
+// love
+#include "common/Module.h"
+#include "modules/event/Event.h"
+#include "modules/graphics/Graphics.h"
+#include "modules/keyboard/sdl/Keyboard.h"
+#include "modules/timer/Timer.h"
+#include "modules/touch/sdl/Touch.h"
+#include "modules/window/Window.h"
+
+// AssetManager
+#include "AssetManager.h"
+
+// Input
+#include "Input.h"
+
+// MainLoop
+#include "MainLoop.h"
+
+// Profiler
+#include "Profiler.h"
+
+// Scene
+#include "Scene.h"
+
+namespace livesim
+{
+namespace base
+{
+
+using love::keyboard::Keyboard;
+
+static bool quitRequested = false;
+static int quitStatus = 0;
+
+// Fixed simulation step. 1000Hz gives 1ms precision for judgement.
+static double tickStep = 1.0 / 1000.0;
+static int maxTicksPerFrame = 250;
+// Time not yet consumed by Scene::tick
+static double tickAccumulator = 0.0;
+// Simulation clock, in love.timer clock. frameTime is the sum of dt
+// passed to stepFrame, tickTime is the time of the current tick.
+static double frameTime = 0.0;
+static double tickTime = 0.0;
+
+// SDL scancode to LOVE key. Resolving it through Keyboard::getKeyFromScancode
+// is a linear search, so the result is cached until the keymap changes.
+static Keyboard::Key keyCache[SDL_NUM_SCANCODES];
+static bool keyCacheValid = false;
+
+static Keyboard::Key getKey(SDL_Scancode sdlsc, Keyboard::Scancode scancode)
+{
+	if (!keyCacheValid)
+	{
+		for (int i = 0; i < SDL_NUM_SCANCODES; i++)
+			keyCache[i] = Keyboard::KEY_MAX_ENUM;
+
+		keyCacheValid = true;
+	}
+
+	if (sdlsc < 0 || sdlsc >= SDL_NUM_SCANCODES)
+		return Keyboard::KEY_UNKNOWN;
+
+	if (keyCache[sdlsc] == Keyboard::KEY_MAX_ENUM)
+	{
+		auto kb = love::Module::getInstance<Keyboard>(love::Module::M_KEYBOARD);
+		keyCache[sdlsc] = kb ? kb->getKeyFromScancode(scancode) : Keyboard::KEY_UNKNOWN;
+	}
+
+	return keyCache[sdlsc];
+}
+
+static void windowToDPICoords(double *x, double *y)
+{
+	auto window = love::Module::getInstance<love::window::Window>(love::Module::M_WINDOW);
+	if (window)
+		window->windowToDPICoords(x, y);
+}
+
+static void dispatchWindowEvent(const SDL_Event &e)
+{
+	auto window = love::Module::getInstance<love::window::Window>(love::Module::M_WINDOW);
+	auto gfx = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
+
+	switch (e.window.event)
+	{
+	case SDL_WINDOWEVENT_FOCUS_GAINED:
+	case SDL_WINDOWEVENT_FOCUS_LOST:
+		getCurrentScene()->focus(e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED);
+		break;
+	case SDL_WINDOWEVENT_ENTER:
+	case SDL_WINDOWEVENT_LEAVE:
+		getCurrentScene()->mouseFocus(e.window.event == SDL_WINDOWEVENT_ENTER);
+		break;
+	case SDL_WINDOWEVENT_SHOWN:
+	case SDL_WINDOWEVENT_HIDDEN:
+		getCurrentScene()->visible(e.window.event == SDL_WINDOWEVENT_SHOWN);
+		break;
+	case SDL_WINDOWEVENT_RESIZED:
+	{
+		// Graphics size is what we want, not the window size.
+		double width = e.window.data1;
+		double height = e.window.data2;
+
+		if (gfx)
+		{
+			width = gfx->getWidth();
+			height = gfx->getHeight();
+		}
+		else if (window)
+		{
+			width = window->getWidth();
+			height = window->getHeight();
+			windowToDPICoords(&width, &height);
+		}
+
+		getCurrentScene()->resize((uint32_t) width, (uint32_t) height);
+		break;
+	}
+	case SDL_WINDOWEVENT_SIZE_CHANGED:
+		if (window)
+			window->onSizeChanged(e.window.data1, e.window.data2);
+		break;
+	default:
+		break;
+	}
+}
+
+static void normalizedToDPICoords(double *x, double *y)
+{
+	double w = 1.0, h = 1.0;
+
+	auto window = love::Module::getInstance<love::window::Window>(love::Module::M_WINDOW);
+	if (window)
+	{
+		w = window->getWidth();
+		h = window->getHeight();
+		window->windowToDPICoords(&w, &h);
+	}
+
+	*x *= w;
+	*y *= h;
+}
+
+static InputEvent newInputEvent(InputEvent::Type type, double time)
+{
+	InputEvent ie;
+	memset(&ie, 0, sizeof(InputEvent));
+	ie.type = type;
+	ie.time = time;
+	return ie;
+}
+
+static void dispatchEvent(const SDL_Event &e, double time)
+{
+	Keyboard::Scancode scancode = Keyboard::SCANCODE_UNKNOWN;
+
+	switch (e.type)
+	{
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	{
+		if (e.key.repeat)
+		{
+			auto kb = love::Module::getInstance<Keyboard>(love::Module::M_KEYBOARD);
+			if (kb && !kb->hasKeyRepeat())
+				break;
+		}
+
+		bool pressed = e.type == SDL_KEYDOWN;
+		InputEvent ie = newInputEvent(pressed ? InputEvent::KEY_PRESSED : InputEvent::KEY_RELEASED, time);
+		love::keyboard::sdl::Keyboard::getConstant(e.key.keysym.scancode, scancode);
+		ie.key = getKey(e.key.keysym.scancode, scancode);
+		ie.scancode = scancode;
+		ie.repeat = e.key.repeat != 0;
+		pushInput(ie);
+
+		if (pressed)
+			getCurrentScene()->keyPressed(ie.key, scancode, ie.repeat);
+		else
+			getCurrentScene()->keyReleased(ie.key, scancode);
+		break;
+	}
+	case SDL_KEYMAPCHANGED:
+		keyCacheValid = false;
+		break;
+	case SDL_TEXTINPUT:
+		getCurrentScene()->textInput(std::string(e.text.text));
+		break;
+	case SDL_MOUSEMOTION:
+	{
+		InputEvent ie = newInputEvent(InputEvent::MOUSE_MOVED, time);
+		ie.x = e.motion.x;
+		ie.y = e.motion.y;
+		ie.dx = e.motion.xrel;
+		ie.dy = e.motion.yrel;
+		ie.istouch = e.motion.which == SDL_TOUCH_MOUSEID;
+		windowToDPICoords(&ie.x, &ie.y);
+		windowToDPICoords(&ie.dx, &ie.dy);
+		pushInput(ie);
+
+		getCurrentScene()->mouseMoved((int32_t) ie.x, (int32_t) ie.y, (int32_t) ie.dx, (int32_t) ie.dy, ie.istouch);
+		break;
+	}
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	{
+		bool pressed = e.type == SDL_MOUSEBUTTONDOWN;
+		InputEvent ie = newInputEvent(pressed ? InputEvent::MOUSE_PRESSED : InputEvent::MOUSE_RELEASED, time);
+
+		// SDL uses button 3 for the right mouse button, but we use button 2
+		ie.button = e.button.button;
+		if (ie.button == SDL_BUTTON_RIGHT)
+			ie.button = 2;
+		else if (ie.button == SDL_BUTTON_MIDDLE)
+			ie.button = 3;
+
+		ie.x = e.button.x;
+		ie.y = e.button.y;
+		ie.istouch = e.button.which == SDL_TOUCH_MOUSEID;
+		windowToDPICoords(&ie.x, &ie.y);
+		pushInput(ie);
+
+		if (pressed)
+			getCurrentScene()->mousePressed((int32_t) ie.x, (int32_t) ie.y, ie.button, ie.istouch);
+		else
+			getCurrentScene()->mouseReleased((int32_t) ie.x, (int32_t) ie.y, ie.button, ie.istouch);
+		break;
+	}
+#ifndef LOVE_MACOSX
+	// Touch events are disabled in OS X, see love.event for the reason.
+	case SDL_FINGERDOWN:
+	case SDL_FINGERUP:
+	case SDL_FINGERMOTION:
+	{
+		InputEvent::Type type = InputEvent::TOUCH_MOVED;
+		if (e.type == SDL_FINGERDOWN)
+			type = InputEvent::TOUCH_PRESSED;
+		else if (e.type == SDL_FINGERUP)
+			type = InputEvent::TOUCH_RELEASED;
+
+		InputEvent ie = newInputEvent(type, time);
+		ie.id = (int64_t) e.tfinger.fingerId;
+		ie.x = e.tfinger.x;
+		ie.y = e.tfinger.y;
+		ie.dx = e.tfinger.dx;
+		ie.dy = e.tfinger.dy;
+		ie.pressure = e.tfinger.pressure;
+		ie.istouch = true;
+
+		// SDL's coords are normalized to [0, 1], but we want screen coords.
+		normalizedToDPICoords(&ie.x, &ie.y);
+		normalizedToDPICoords(&ie.dx, &ie.dy);
+		pushInput(ie);
+
+		// Keep love.touch.getTouches up to date
+		auto touch = (love::touch::sdl::Touch *) love::Module::getInstance("love.touch.sdl");
+		if (touch)
+		{
+			love::touch::Touch::TouchInfo info = {ie.id, ie.x, ie.y, ie.dx, ie.dy, ie.pressure};
+			touch->onEvent(e.type, info);
+		}
+
+		if (type == InputEvent::TOUCH_PRESSED)
+			getCurrentScene()->touchPressed(ie.id, ie.x, ie.y, ie.dx, ie.dy, ie.pressure);
+		else if (type == InputEvent::TOUCH_RELEASED)
+			getCurrentScene()->touchReleased(ie.id, ie.x, ie.y, ie.dx, ie.dy, ie.pressure);
+		else
+			getCurrentScene()->touchMoved(ie.id, ie.x, ie.y, ie.dx, ie.dy, ie.pressure);
+		break;
+	}
+#endif
+	case SDL_WINDOWEVENT:
+		dispatchWindowEvent(e);
+		break;
+	case SDL_QUIT:
+	case SDL_APP_TERMINATING:
+		quit(0);
+		break;
+	default:
+		break;
+	}
+}
+
+// Run pending fixed steps then return the interpolation factor.
+static double runTicks(double dt)
+{
+	if (tickStep <= 0.0)
+	{
+		tickTime = frameTime;
+		discardInput(tickTime);
+		return 1.0;
+	}
+
+	tickAccumulator += dt;
+	int ticks = 0;
+
+	while (tickAccumulator >= tickStep)
+	{
+		if (ticks >= maxTicksPerFrame)
+		{
+			// Too far behind. Drop the rest.
+			tickAccumulator = std::fmod(tickAccumulator, tickStep);
+			break;
+		}
+
+		tickAccumulator -= tickStep;
+		tickTime = frameTime - tickAccumulator;
+		getCurrentScene()->tick(tickStep);
+		ticks++;
+	}
+
+	// Input which the scene didn't take is stale now.
+	discardInput(tickTime);
+	return tickAccumulator / tickStep;
+}
+
+static void pollEvents()
+{
+	// Like love.run, no event pumping without love.event
+	auto ev = love::Module::getInstance<love::event::Event>(love::Module::M_EVENT);
+	if (ev == nullptr)
+		return;
+
+	SDL_Event e;
+
+	// SDL timestamps are in SDL_GetTicks milliseconds. Convert them to
+	// love.timer clock by their age relative to now.
+	//
+	// SDL stamps an event when it's queued. Desktop input is only queued
+	// when the OS queue is pumped here, so it gets poll time, and is at
+	// most a frame late. Only events queued by other threads as they
+	// happen (e.g. Android touch) get their real time, to the millisecond.
+	SDL_PumpEvents();
+	double now = love::timer::Timer::getTime();
+	uint32_t nowTicks = SDL_GetTicks();
+
+	while (SDL_PollEvent(&e))
+	{
+		// Events which arrive after SDL_GetTicks above have negative age
+		int32_t age = (int32_t) (nowTicks - e.common.timestamp);
+		double time = age > 0 ? now - age / 1000.0 : now;
+
+		dispatchEvent(e, time);
+	}
+
+	// Messages pushed through love.event, like lovewrap::event::quit
+	love::event::Message *msg = nullptr;
+
+	while (ev->poll(msg))
+	{
+		if (msg->getName() == "quit")
+		{
+			const std::vector<love::Variant> &args = msg->getArgs();
+			quit(args.empty() ? 0 : (int) args[0].getNumber());
+		}
+
+		msg->release();
+	}
+}
+
+void stepFrame(double dt)
+{
+	double alpha = 1.0;
+	frameTime += dt;
+
+	{
+		// Upload assets decoded by worker threads
+		LIVESIM_PROFILE(SECTION_ASSET);
+		livesim::asset::update();
+	}
+
+	{
+		LIVESIM_PROFILE(SECTION_UPDATE);
+		getCurrentScene()->update(dt);
+	}
+
+	{
+		LIVESIM_PROFILE(SECTION_TICK);
+		alpha = runTicks(dt);
+	}
+
+	auto gfx = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
+	if (gfx && gfx->isActive())
+	{
+		{
+			LIVESIM_PROFILE(SECTION_DRAW);
+			gfx->origin();
+			gfx->clear(love::graphics::OptionalColorf(gfx->getBackgroundColor()), love::OptionalInt(), love::OptionalDouble());
+			getCurrentScene()->drawInterpolated(alpha);
+		}
+
+		if (profiler::isEnabled())
+		{
+			// Flush explicitly so it's not counted as present.
+			// Stats must be taken before present resets them.
+			{
+				LIVESIM_PROFILE(SECTION_FLUSH);
+				gfx->flushStreamDraws();
+			}
+
+			profiler::setGraphicsStats(gfx->getStats());
+
+			if (profiler::isOverlayVisible())
+				profiler::drawOverlay();
+		}
+
+		{
+			LIVESIM_PROFILE(SECTION_PRESENT);
+			gfx->present(nullptr);
+		}
+	}
+
+	{
+		LIVESIM_PROFILE(SECTION_SWAP);
+		swapScene();
+	}
+}
+
+int runMainLoop()
+{
+	auto timer = love::Module::getInstance<love::timer::Timer>(love::Module::M_TIMER);
+
+	quitRequested = false;
+	quitStatus = 0;
+	tickAccumulator = 0.0;
+
+	// We don't want the first frame's dt to include time taken by boot
+	if (timer)
+		timer->step();
+
+	// Sum of dt follows love.timer clock from here
+	frameTime = tickTime = love::timer::Timer::getTime();
+	clearInput();
+
+	while (!quitRequested)
+	{
+		profiler::beginFrame();
+
+		{
+			LIVESIM_PROFILE(SECTION_EVENT);
+			pollEvents();
+		}
+
+		if (quitRequested)
+			break;
+
+		stepFrame(timer ? timer->step() : 0.0);
+		profiler::endFrame();
+
+		if (timer)
+			timer->sleep(0.001);
+	}
+
+	return quitStatus;
+}
+
+void quit(int exitStatus)
+{
+	quitRequested = true;
+	quitStatus = exitStatus;
+}
+
+void setTickRate(double hz)
+{
+	tickStep = hz > 0.0 ? 1.0 / hz : 0.0;
+	tickAccumulator = 0.0;
+}
+
+double getTickTime()
+{
+	return tickTime;
+}
+
+double getTickRate()
+{
+	return tickStep > 0.0 ? 1.0 / tickStep : 0.0;
+}
+
+void setMaxTicksPerFrame(int ticks)
+{
+	maxTicksPerFrame = std::max(ticks, 1);
+}
+
+int getMaxTicksPerFrame()
+{
+	return maxTicksPerFrame;
+}
+
+} // base
+} // livesim
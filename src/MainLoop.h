@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_MAINLOOP_H
+#define LIVESIM_MAINLOOP_H
+
+namespace livesim
+{
+namespace base
+{
+
+/**
+ * Run the game loop natively. This replaces love.run: events are pumped
+ * from SDL and dispatched straight to the current Scene, without going
+ * through Lua.
+ *
+ * @return Exit status.
+ */
+int runMainLoop();
+/**
+ * Run single frame without polling events: asset uploads, Scene::update,
+ * Scene::tick, drawing (if graphics is active) and scene swap.
+ * This is what runMainLoop calls every frame.
+ *
+ * @param dt Time elapsed since previous frame, in seconds.
+ */
+void stepFrame(double dt);
+/**
+ * Request the main loop to stop after current frame.
+ *
+ * @param exitStatus Value returned by runMainLoop.
+ */
+void quit(int exitStatus = 0);
+/**
+ * Get simulation time of the current tick. Inside Scene::tick, input events
+ * up to this time should be processed, see pollInput.
+ *
+ * @return Tick time, in love.timer clock.
+ */
+double getTickTime();
+/**
+ * Set rate of fixed simulation step (Scene::tick).
+ *
+ * @param hz Ticks per second. 0 disables Scene::tick.
+ */
+void setTickRate(double hz);
+/**
+ * Get rate of fixed simulation step.
+ *
+ * @return Ticks per second, or 0 if disabled.
+ */
+double getTickRate();
+/**
+ * Set maximum amount of ticks run in single frame. When the game stalls
+ * longer than this, the remaining time is dropped instead of catching up,
+ * so one long frame can't make the next frames longer.
+ *
+ * @param ticks Maximum ticks per frame.
+ */
+void setMaxTicksPerFrame(int ticks);
+/**
+ * Get maximum amount of ticks run in single frame.
+ *
+ * @return Maximum ticks per frame.
+ */
+int getMaxTicksPerFrame();
+
+} // base
+} // livesim
+
+#endif
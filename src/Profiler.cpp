@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// love
+#include "common/Module.h"
+#include "modules/filesystem/Filesystem.h"
+#include "modules/timer/Timer.h"
+
+// Profiler
+#include "Profiler.h"
+
+namespace livesim
+{
+namespace profiler
+{
+
+// Each slot is guarded by a sequence number. The writer makes it odd while
+// the frame is written, so readers can detect torn copies and retry.
+struct Slot
+{
+	std::atomic<uint32_t> sequence;
+	Frame frame;
+};
+
+static Slot history[HISTORY_SIZE];
+// Amount of frames ever published.
+static std::atomic<uint64_t> published(0);
+
+static std::atomic<bool> enabled(false);
+static bool overlayVisible = false;
+
+// Frame being measured. Only touched by main thread.
+static Frame current;
+static bool inFrame = false;
+static uint64_t frameCounter = 0;
+
+static const char *sectionNames[SECTION_MAX_ENUM] = {
+	"event",
+	"asset",
+	"update",
+	"tick",
+	"draw",
+	"flush",
+	"present",
+	"swap"
+};
+
+static bool readSlot(const Slot &slot, Frame &out)
+{
+	for (int tries = 0; tries < 8; tries++)
+	{
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+
+		memcpy(&out, &slot.frame, sizeof(Frame));
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (slot.sequence.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+
+	return false;
+}
+
+void setEnabled(bool enable)
+{
+	if (enable && !enabled)
+	{
+		frameCounter = 0;
+		published = 0;
+	}
+
+	inFrame = false;
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void setOverlayVisible(bool visible)
+{
+	overlayVisible = visible;
+}
+
+bool isOverlayVisible()
+{
+	return overlayVisible && isEnabled();
+}
+
+void beginFrame()
+{
+	if (!isEnabled())
+		return;
+
+	memset(&current, 0, sizeof(Frame));
+	current.index = frameCounter++;
+	current.start = love::timer::Timer::getTime();
+	inFrame = true;
+}
+
+void endFrame()
+{
+	if (!isEnabled() || !inFrame)
+		return;
+
+	current.total = love::timer::Timer::getTime() - current.start;
+	inFrame = false;
+
+	uint64_t n = published.load(std::memory_order_relaxed);
+	Slot &slot = history[n % HISTORY_SIZE];
+	uint32_t seq = slot.sequence.load(std::memory_order_relaxed);
+
+	slot.sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&slot.frame, &current, sizeof(Frame));
+	slot.sequence.store(seq + 2, std::memory_order_release);
+
+	published.store(n + 1, std::memory_order_release);
+}
+
+void addTime(Section section, double seconds)
+{
+	if (inFrame && section >= 0 && section < SECTION_MAX_ENUM)
+		current.sections[section] += seconds;
+}
+
+void setGraphicsStats(const love::graphics::Graphics::Stats &stats)
+{
+	if (!inFrame)
+		return;
+
+	current.drawCalls = stats.drawCalls;
+	current.drawCallsBatched = stats.drawCallsBatched;
+	current.shaderSwitches = stats.shaderSwitches;
+	current.canvasSwitches = stats.canvasSwitches;
+	current.textureMemory = stats.textureMemory;
+}
+
+size_t getFrames(Frame *out, size_t count)
+{
+	uint64_t n = published.load(std::memory_order_acquire);
+	uint64_t available = std::min<uint64_t>(n, HISTORY_SIZE);
+	size_t amount = (size_t) std::min<uint64_t>(available, count);
+	size_t copied = 0;
+
+	for (uint64_t i = n - amount; i < n; i++)
+	{
+		// Skip frames being overwritten by the writer.
+		if (readSlot(history[i % HISTORY_SIZE], out[copied]) && out[copied].index == i)
+			copied++;
+	}
+
+	return copied;
+}
+
+bool getLastFrame(Frame &out)
+{
+	return getFrames(&out, 1) == 1;
+}
+
+const char *getSectionName(Section section)
+{
+	if (section < 0 || section >= SECTION_MAX_ENUM)
+		return nullptr;
+
+	return sectionNames[section];
+}
+
+void dumpCSV(const std::string &filename)
+{
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+	if (fs == nullptr)
+		throw love::Exception("love.filesystem is not loaded");
+
+	std::vector<Frame> frames(HISTORY_SIZE);
+	frames.resize(getFrames(frames.data(), frames.size()));
+
+	std::string csv = "frame,start,total";
+	for (int i = 0; i < SECTION_MAX_ENUM; i++)
+	{
+		csv += ',';
+		csv += sectionNames[i];
+	}
+	csv += ",drawcalls,drawcallsbatched,shaderswitches,canvasswitches,texturememory\n";
+
+	char buf[64];
+	for (const Frame &f: frames)
+	{
+		sprintf(buf, "%llu,%.6f,%.6f", (unsigned long long) f.index, f.start, f.total);
+		csv += buf;
+
+		for (int i = 0; i < SECTION_MAX_ENUM; i++)
+		{
+			sprintf(buf, ",%.6f", f.sections[i]);
+			csv += buf;
+		}
+
+		sprintf(buf, ",%d,%d,%d,%d,%lld\n", f.drawCalls, f.drawCallsBatched, f.shaderSwitches, f.canvasSwitches, (long long) f.textureMemory);
+		csv += buf;
+	}
+
+	fs->write(filename.c_str(), csv.data(), (love::int64) csv.length());
+}
+
+void drawOverlay(float x, float y)
+{
+	auto gfx = love::Module::getInstance<love::graphics::Graphics>(love::Module::M_GRAPHICS);
+	Frame f;
+
+	if (gfx == nullptr || !getLastFrame(f))
+		return;
+
+	char buf[128];
+	std::string text;
+
+	sprintf(buf, "frame %.3fms\n", f.total * 1000.0);
+	text += buf;
+
+	for (int i = 0; i < SECTION_MAX_ENUM; i++)
+	{
+		sprintf(buf, "%s %.3fms\n", sectionNames[i], f.sections[i] * 1000.0);
+		text += buf;
+	}
+
+	sprintf(buf, "drawcalls %d (%d batched)\nshader switches %d", f.drawCalls, f.drawCallsBatched, f.shaderSwitches);
+	text += buf;
+
+	std::vector<love::graphics::Font::ColoredString> str(1);
+	str[0].str = text;
+	str[0].color = love::Colorf(1.0f, 1.0f, 0.0f, 1.0f);
+
+	gfx->push();
+	gfx->origin();
+	gfx->print(str, love::Matrix4(x, y, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+	gfx->pop();
+}
+
+ScopedTimer::ScopedTimer(Section section)
+	: section(section)
+	, start(-1.0)
+{
+	if (isEnabled())
+		start = love::timer::Timer::getTime();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	if (start >= 0.0)
+		addTime(section, love::timer::Timer::getTime() - start);
+}
+
+} // profiler
+} // livesim
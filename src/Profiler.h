@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_PROFILER_H
+#define LIVESIM_PROFILER_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// love
+#include "modules/graphics/Graphics.h"
+
+namespace livesim
+{
+namespace profiler
+{
+
+/* Timed parts of a frame */
+enum Section
+{
+	SECTION_EVENT,
+	SECTION_ASSET,
+	SECTION_UPDATE,
+	SECTION_TICK,
+	SECTION_DRAW,
+	SECTION_FLUSH,
+	SECTION_PRESENT,
+	SECTION_SWAP,
+	SECTION_MAX_ENUM
+};
+
+/* Measurement of single frame */
+struct Frame
+{
+	// Frame number, starting from 0 when profiling is enabled.
+	uint64_t index;
+	// Time when the frame starts, in love.timer time.
+	double start;
+	// Time spent between beginFrame and endFrame, in seconds.
+	double total;
+	// Time spent in each section, in seconds.
+	double sections[SECTION_MAX_ENUM];
+	// Graphics statistics, taken before present.
+	int drawCalls;
+	int drawCallsBatched;
+	int shaderSwitches;
+	int canvasSwitches;
+	int64_t textureMemory;
+};
+
+/* Amount of frames kept in the history. */
+const size_t HISTORY_SIZE = 256;
+
+/**
+ * Enable or disable profiling. When disabled, scoped timers only
+ * cost a single branch.
+ *
+ * @param enable Whether to collect frame statistics.
+ */
+void setEnabled(bool enable);
+/**
+ * Is profiling enabled?
+ *
+ * @return true if frame statistics are collected.
+ */
+bool isEnabled();
+/**
+ * Show or hide the statistics overlay in main loop.
+ *
+ * @param visible Whether to draw the overlay. Has no effect when profiling is disabled.
+ */
+void setOverlayVisible(bool visible);
+/**
+ * Is the statistics overlay drawn?
+ *
+ * @return true if overlay is visible.
+ */
+bool isOverlayVisible();
+
+/* Start measuring new frame. Main thread only. */
+void beginFrame();
+/* Finish current frame and publish it to the history. Main thread only. */
+void endFrame();
+/**
+ * Add elapsed time to a section of current frame. Main thread only.
+ *
+ * @param section The section.
+ * @param seconds Elapsed time, in seconds.
+ */
+void addTime(Section section, double seconds);
+/**
+ * Record graphics statistics of current frame. Must be called before
+ * Graphics::present, as present resets the counters.
+ *
+ * @param stats Graphics statistics.
+ */
+void setGraphicsStats(const love::graphics::Graphics::Stats &stats);
+
+/**
+ * Copy most recent frames. Safe to call from any thread.
+ *
+ * @param out Destination array.
+ * @param count Maximum amount of frames to copy.
+ * @return Amount of frames copied, ordered from oldest to newest.
+ */
+size_t getFrames(Frame *out, size_t count);
+/**
+ * Get most recent finished frame.
+ *
+ * @param out Where the frame is copied to.
+ * @return true if there's such frame, false otherwise.
+ */
+bool getLastFrame(Frame &out);
+/**
+ * Get name of a section.
+ *
+ * @param section The section.
+ * @return Section name, or nullptr if invalid.
+ */
+const char *getSectionName(Section section);
+/**
+ * Write frame history as CSV to save directory.
+ *
+ * @param filename Destination file name.
+ */
+void dumpCSV(const std::string &filename);
+/**
+ * Draw statistics of the last frame.
+ *
+ * @param x Overlay x position.
+ * @param y Overlay y position.
+ */
+void drawOverlay(float x = 4.0f, float y = 4.0f);
+
+/* Measure time spent in a scope. */
+class ScopedTimer
+{
+public:
+	ScopedTimer(Section section);
+	~ScopedTimer();
+private:
+	Section section;
+	double start;
+};
+
+} // profiler
+} // livesim
+
+#define LIVESIM_PROFILE_CONCAT2(a, b) a##b
+#define LIVESIM_PROFILE_CONCAT(a, b) LIVESIM_PROFILE_CONCAT2(a, b)
+/* Measure time spent until the end of current scope. */
+#define LIVESIM_PROFILE(section) livesim::profiler::ScopedTimer LIVESIM_PROFILE_CONCAT(profileScope_, __LINE__)(livesim::profiler::section)
+
+#endif
@@ -20,12 +20,20 @@
 
 // std
 #include <algorithm>
+#include <atomic>
+#include <map>
 #include <type_traits>
 #include <vector>
 
 // Scene.h
 #include "Scene.h"
 
+// ThreadPool
+#include "ThreadPool.h"
+
+// love
+#include "modules/thread/threads.h"
+
 #define DUMMY_FUNC(f, ...) void livesim::base::Scene::##f(__VA_ARGS__) {}
 
 livesim::base::Scene::Scene(void *) {}
@@ -34,6 +42,7 @@ livesim::base::Scene::~Scene() {}
 // Lazy mode
 DUMMY_FUNC(draw, void)
 DUMMY_FUNC(update, double)
+DUMMY_FUNC(tick, double)
 DUMMY_FUNC(focus, bool)
 DUMMY_FUNC(visible, bool)
 DUMMY_FUNC(resize, uint32_t, uint32_t)
@@ -44,6 +53,25 @@ DUMMY_FUNC(mousePressed, int32_t, int32_t, int32_t, bool)
 DUMMY_FUNC(mouseReleased, int32_t, int32_t, int32_t, bool)
 DUMMY_FUNC(mouseMoved, int32_t, int32_t, int32_t, int32_t, bool)
 DUMMY_FUNC(mouseFocus, bool)
+DUMMY_FUNC(touchPressed, int64_t, double, double, double, double, double)
+DUMMY_FUNC(touchReleased, int64_t, double, double, double, double, double)
+DUMMY_FUNC(touchMoved, int64_t, double, double, double, double, double)
+DUMMY_FUNC(preload, void)
+
+void livesim::base::Scene::drawInterpolated(double)
+{
+	draw();
+}
+
+bool livesim::base::Scene::isReady()
+{
+	return true;
+}
+
+double livesim::base::Scene::getProgress()
+{
+	return 1.0;
+}
 
 namespace livesim
 {
@@ -54,15 +82,47 @@ namespace base
 Scene *currentScene;
 // Queued scene.
 Scene *queuedScene;
+// Worker thread for Scene::preload
+static ThreadPool *scenePreloader;
+// Incremented every time new scene is queued.
+static uint32_t queuedGeneration;
+// Last generation which preload is finished.
+static std::atomic<uint32_t> preloadedGeneration;
+// Scenes which preload is finished, to be released in main thread.
+// Releasing them in the worker could free graphics objects there.
+static love::thread::MutexRef preloadedMutex;
+static std::vector<Scene*> preloadedScenes;
+
+// Release scenes handed back by the preloader. Main thread only!
+static void releasePreloadedScenes()
+{
+	std::vector<Scene*> scenes;
+
+	{
+		love::thread::Lock lock(preloadedMutex);
+		scenes.swap(preloadedScenes);
+	}
+
+	for (Scene *s: scenes)
+		s->release();
+}
 
 void initializeScene()
 {
 	currentScene = nullptr;
 	queuedScene = nullptr;
+	scenePreloader = nullptr;
+	queuedGeneration = 0;
+	preloadedGeneration = 0;
 }
 
 void freeScene()
 {
+	// Wait for running preload
+	delete scenePreloader;
+	scenePreloader = nullptr;
+	releasePreloadedScenes();
+
 	// Free current scene
 	getCurrentScene()->release();
 
@@ -78,19 +138,63 @@ Scene *getCurrentScene()
 	return currentScene;
 }
 
-void loadScene(Scene *scene)
+void loadScene(Scene *scene, bool preload)
 {
-	// If there's previously loaded scene, unload that one
+	// If there's previously loaded scene, unload that one.
+	// If it's still preloading, the worker holds its own reference
+	// which is handed back to swapScene.
 	if (queuedScene)
 		queuedScene->release();
 
 	queuedScene = scene;
+	uint32_t generation = ++queuedGeneration;
+
+	if (!preload)
+	{
+		preloadedGeneration = generation;
+		return;
+	}
+
+	if (scenePreloader == nullptr)
+		scenePreloader = new ThreadPool(1, "livesim4 scene preloader");
+
+	scene->retain();
+	scenePreloader->submit([scene, generation]()
+	{
+		try
+		{
+			scene->preload();
+		}
+		catch (std::exception &) {}
+
+		// Never go back to older generation
+		uint32_t current = preloadedGeneration;
+		while (current < generation && !preloadedGeneration.compare_exchange_weak(current, generation)) {}
+
+		love::thread::Lock lock(preloadedMutex);
+		preloadedScenes.push_back(scene);
+	});
+}
+
+bool isSceneLoading()
+{
+	return queuedScene != nullptr;
+}
+
+double getLoadingProgress()
+{
+	if (queuedScene == nullptr)
+		return 1.0;
+
+	return std::min(std::max(queuedScene->getProgress(), 0.0), 1.0);
 }
 
 void swapScene()
 {
 	// Usually called just before love.draw returns.
-	if (queuedScene)
+	releasePreloadedScenes();
+
+	if (queuedScene && preloadedGeneration == queuedGeneration && queuedScene->isReady())
 	{
 		getCurrentScene()->release();
 		currentScene = queuedScene;
@@ -98,5 +202,39 @@ void swapScene()
 	}
 }
 
+// Registered scenes. Function-local so registration from static
+// initializers in other translation units is safe.
+static std::map<std::string, SceneFactory> &getSceneRegistry()
+{
+	static std::map<std::string, SceneFactory> registry;
+	return registry;
+}
+
+void registerScene(const std::string &name, SceneFactory factory)
+{
+	getSceneRegistry()[name] = factory;
+}
+
+Scene *newScene(const std::string &name, void *args)
+{
+	auto &registry = getSceneRegistry();
+	auto it = registry.find(name);
+
+	if (it == registry.end())
+		return nullptr;
+
+	return it->second(args);
+}
+
+std::vector<std::string> getSceneNames()
+{
+	std::vector<std::string> names;
+
+	for (auto &x: getSceneRegistry())
+		names.push_back(x.first);
+
+	return names;
+}
+
 } // base
 } // livesim
@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 // love
 #include "common/Object.h"
@@ -47,12 +48,27 @@ public:
 	virtual ~Scene();
 	/* This is basically your drawing function. */
 	virtual void draw();
+	/**
+	 * Drawing function with interpolation factor between the previous and
+	 * the current simulation tick. Default implementation calls draw().
+	 *
+	 * @param alpha Interpolation factor, from 0 to 1.
+	 */
+	virtual void drawInterpolated(double alpha);
 	/**
 	 * This is basically your update function.
 	 *
 	 * @param deltaT Elapsed time of previous frame.
 	 */
 	virtual void update(double deltaT);
+	/**
+	 * Fixed-rate simulation step. Called zero or more times each frame,
+	 * after update(), so that game logic runs independently of frame rate.
+	 *
+	 * @param step Duration of one tick, in seconds. Always the same value
+	 *             unless the tick rate is changed.
+	 */
+	virtual void tick(double step);
 	/**
 	 * On window focus
 	 *
@@ -129,6 +145,59 @@ public:
 	 * @param f Whether the window has mouse focus or not.
 	 */
 	virtual void mouseFocus(bool focus);
+	/**
+	 * On touch pressed
+	 *
+	 * @param id The identifier for the touch press. Only unique for the duration of the touch-press.
+	 * @param x The x-axis position of the touch inside the window, in pixels.
+	 * @param y The y-axis position of the touch inside the window, in pixels.
+	 * @param dx The x-axis movement of the touch inside the window, in pixels.
+	 * @param dy The y-axis movement of the touch inside the window, in pixels.
+	 * @param pressure The amount of pressure being applied. Most touch screens aren't pressure sensitive, in which case the pressure will be 1.
+	 */
+	virtual void touchPressed(int64_t id, double x, double y, double dx, double dy, double pressure);
+	/**
+	 * On touch released
+	 *
+	 * @param id The identifier for the touch press. Only unique for the duration of the touch-press.
+	 * @param x The x-axis position of the touch inside the window, in pixels.
+	 * @param y The y-axis position of the touch inside the window, in pixels.
+	 * @param dx The x-axis movement of the touch inside the window, in pixels.
+	 * @param dy The y-axis movement of the touch inside the window, in pixels.
+	 * @param pressure The amount of pressure being applied. Most touch screens aren't pressure sensitive, in which case the pressure will be 1.
+	 */
+	virtual void touchReleased(int64_t id, double x, double y, double dx, double dy, double pressure);
+	/**
+	 * On touch moved
+	 *
+	 * @param id The identifier for the touch press. Only unique for the duration of the touch-press.
+	 * @param x The x-axis position of the touch inside the window, in pixels.
+	 * @param y The y-axis position of the touch inside the window, in pixels.
+	 * @param dx The x-axis movement of the touch inside the window, in pixels.
+	 * @param dy The y-axis movement of the touch inside the window, in pixels.
+	 * @param pressure The amount of pressure being applied. Most touch screens aren't pressure sensitive, in which case the pressure will be 1.
+	 */
+	virtual void touchMoved(int64_t id, double x, double y, double dx, double dy, double pressure);
+	/**
+	 * Load scene resources in background. Only called when the scene is
+	 * queued with preloading enabled. This runs in worker thread, so
+	 * love.graphics must not be used here. Use livesim::asset async
+	 * functions instead.
+	 */
+	virtual void preload();
+	/**
+	 * Is the scene ready to be shown? This is polled from main thread every frame
+	 * after preload() is finished, until it returns true.
+	 *
+	 * @return true if the scene can be switched to.
+	 */
+	virtual bool isReady();
+	/**
+	 * Get loading progress of the scene, for loading bar.
+	 *
+	 * @return Loading progress, from 0 to 1.
+	 */
+	virtual double getProgress();
 };
 
 /* Initialize scene system */
@@ -146,11 +215,64 @@ Scene *getCurrentScene();
  * Queue new scene loading.
  *
  * @param scene The scene object to queue.
+ * @param preload Run Scene::preload in worker thread while current scene keeps running.
+ */
+void loadScene(Scene *scene, bool preload = false);
+/**
+ * Is there queued scene which is still loading?
+ *
+ * @return true if queued scene is not ready yet.
  */
-void loadScene(Scene *scene);
-/* Swap scene. Should not be called directly! */
+bool isSceneLoading();
+/**
+ * Get loading progress of queued scene.
+ *
+ * @return Loading progress from 0 to 1, or 1 if there's no queued scene.
+ */
+double getLoadingProgress();
+/* Swap scene if the queued scene is ready. Should not be called directly! */
 void swapScene();
 
+/* Function which creates new scene object. */
+typedef Scene *(*SceneFactory)(void *args);
+
+/**
+ * Register scene so it can be created by name, e.g. by the benchmark.
+ *
+ * @param name Scene name.
+ * @param factory Function to create the scene.
+ */
+void registerScene(const std::string &name, SceneFactory factory);
+/**
+ * Create new registered scene.
+ *
+ * @param name Scene name.
+ * @param args Arguments passed to the scene constructor.
+ * @return New scene object, or nullptr if there's no such scene.
+ */
+Scene *newScene(const std::string &name, void *args = nullptr);
+/**
+ * Get names of all registered scenes.
+ *
+ * @return List of scene names, sorted.
+ */
+std::vector<std::string> getSceneNames();
+
+/* Register scene T on static initialization. */
+template<typename T>
+struct SceneRegistrar
+{
+	SceneRegistrar(const std::string &name)
+	{
+		registerScene(name, &create);
+	}
+
+	static Scene *create(void *args)
+	{
+		return new T(args);
+	}
+};
+
 } // base
 } // livesim
 
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <exception>
+
+// SDL
+#include <SDL_cpuinfo.h>
+
+// ThreadPool
+#include "ThreadPool.h"
+
+namespace livesim
+{
+namespace base
+{
+
+ThreadPool::Worker::Worker(ThreadPool *pool, const std::string &name)
+	: pool(pool)
+{
+	threadName = name;
+}
+
+void ThreadPool::Worker::threadFunction()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+
+		{
+			love::thread::Lock lock(pool->mutex);
+
+			while (pool->jobs.empty() && !pool->quit)
+				pool->jobAvailable->wait(pool->mutex);
+
+			if (pool->jobs.empty())
+				// Quit requested and nothing left to do
+				return;
+
+			job = std::move(pool->jobs.front());
+			pool->jobs.pop_front();
+		}
+
+		try
+		{
+			job();
+		}
+		catch (std::exception &) {}
+
+		{
+			love::thread::Lock lock(pool->mutex);
+			pool->pending--;
+			pool->jobFinished->broadcast();
+		}
+	}
+}
+
+ThreadPool::ThreadPool(int threads, const std::string &name)
+	: pending(0)
+	, quit(false)
+{
+	if (threads <= 0)
+		threads = getDefaultThreadCount();
+
+	for (int i = 0; i < threads; i++)
+	{
+		Worker *w = new Worker(this, name);
+		w->start();
+		workers.push_back(w);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		love::thread::Lock lock(mutex);
+		quit = true;
+		jobAvailable->broadcast();
+	}
+
+	for (Worker *w: workers)
+	{
+		w->wait();
+		w->release();
+	}
+}
+
+void ThreadPool::submit(const std::function<void()> &job)
+{
+	love::thread::Lock lock(mutex);
+	jobs.push_back(job);
+	pending++;
+	jobAvailable->signal();
+}
+
+void ThreadPool::wait()
+{
+	love::thread::Lock lock(mutex);
+
+	while (pending > 0)
+		jobFinished->wait(mutex);
+}
+
+int ThreadPool::getPendingCount()
+{
+	love::thread::Lock lock(mutex);
+	return pending;
+}
+
+int ThreadPool::getThreadCount() const
+{
+	return (int) workers.size();
+}
+
+int ThreadPool::getDefaultThreadCount()
+{
+	int count = SDL_GetCPUCount() - 1;
+	return count < 1 ? 1 : count;
+}
+
+} // base
+} // livesim
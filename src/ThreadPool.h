@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_THREADPOOL_H
+#define LIVESIM_THREADPOOL_H
+
+// std
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// love
+#include "modules/thread/threads.h"
+
+namespace livesim
+{
+namespace base
+{
+
+/* Fixed-size pool of worker threads which run submitted jobs in FIFO order. */
+class ThreadPool
+{
+public:
+	/**
+	 * Create new thread pool.
+	 *
+	 * @param threads Amount of worker threads. 0 means CPU count minus 1 (minimum 1).
+	 * @param name Name given to the worker threads.
+	 */
+	ThreadPool(int threads = 0, const std::string &name = "livesim4 worker");
+	/* Wait for pending jobs then stop all worker threads. */
+	~ThreadPool();
+	/**
+	 * Queue a job. The job is run on one of the worker threads.
+	 * Jobs must not throw; any exception is swallowed by the worker.
+	 *
+	 * @param job Function to run.
+	 */
+	void submit(const std::function<void()> &job);
+	/* Block until all submitted jobs are finished. */
+	void wait();
+	/**
+	 * Get amount of jobs which are queued or still running.
+	 *
+	 * @return Pending job count.
+	 */
+	int getPendingCount();
+	/**
+	 * Get amount of worker threads.
+	 *
+	 * @return Worker thread count.
+	 */
+	int getThreadCount() const;
+
+	/**
+	 * Get default amount of worker threads based on CPU count.
+	 *
+	 * @return CPU count minus 1, but at least 1.
+	 */
+	static int getDefaultThreadCount();
+
+private:
+	class Worker: public love::thread::Threadable
+	{
+	public:
+		Worker(ThreadPool *pool, const std::string &name);
+		void threadFunction();
+	private:
+		ThreadPool *pool;
+	};
+
+	std::vector<Worker*> workers;
+	std::deque<std::function<void()>> jobs;
+	int pending;
+	bool quit;
+
+	love::thread::MutexRef mutex;
+	love::thread::ConditionalRef jobAvailable;
+	love::thread::ConditionalRef jobFinished;
+};
+
+} // base
+} // livesim
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_BEATMAP_H
+#define LIVESIM_BEATMAP_BEATMAP_H
+
+// std
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/*
+ * Single note, in the exact layout of FiLive! BMAP note data so note list
+ * can be decoded directly into array of this.
+ */
+struct Note
+{
+	enum Effect
+	{
+		EFFECT_NORMAL = 0,
+		EFFECT_TOKEN,
+		EFFECT_LONG,
+		EFFECT_STAR
+	};
+
+	enum Visibility
+	{
+		VISIBILITY_NORMAL = 0,
+		VISIBILITY_HIDDEN,
+		VISIBILITY_SUDDEN,
+		VISIBILITY_INVALID
+	};
+
+	// Timing in seconds
+	float time;
+	// Note image and color
+	uint32_t attribute;
+	// Position, effect, visibility, swing and group
+	uint32_t info;
+	// Long note length in seconds
+	float length;
+
+	// Position, 9 is leftmost and 1 is rightmost.
+	inline int getPosition() const { return info & 15; }
+	inline Effect getEffect() const { return (Effect) ((info >> 4) & 3); }
+	inline Visibility getVisibility() const { return (Visibility) ((info >> 6) & 3); }
+	inline bool isSwing() const { return ((info >> 8) & 1) != 0; }
+	inline uint32_t getGroup() const { return info >> 9; }
+	inline int getImage() const { return attribute & 31; }
+	inline bool isCustomColor() const { return (attribute & 31) == 31; }
+
+	// 9-bit color components, only meaningful if isCustomColor() is true.
+	inline void getColor(int &r, int &g, int &b) const
+	{
+		r = (attribute >> 23) & 511;
+		g = (attribute >> 14) & 511;
+		b = (attribute >> 5) & 511;
+	}
+
+	inline bool isValid() const
+	{
+		int pos = getPosition();
+		Effect effect = getEffect();
+
+		if (pos < 1 || pos > 9 || getVisibility() == VISIBILITY_INVALID || !std::isfinite(time))
+			return false;
+		if (effect == EFFECT_STAR && isSwing())
+			return false;
+		if (effect == EFFECT_LONG && !(length > 0.0f && std::isfinite(length)))
+			return false;
+
+		return true;
+	}
+};
+
+static_assert(sizeof(Note) == 16, "Note must match BMAP note layout");
+
+/* Score and combo rank thresholds */
+enum Rank
+{
+	RANK_C = 0,
+	RANK_B,
+	RANK_A,
+	RANK_S,
+	RANK_MAX_ENUM
+};
+
+/* Song information, common to all difficulties */
+struct BeatmapInfo
+{
+	std::string beatmapper;
+	std::string songName;
+	std::string songInfo;
+	int background;
+	int noteStyle;
+};
+
+struct Difficulty
+{
+	std::string name;
+	int star;
+	int randomStar;
+	uint32_t score[RANK_MAX_ENUM];
+	uint32_t combo[RANK_MAX_ENUM];
+	// Number of notes as stored in file, including invalid ones.
+	uint32_t noteCount;
+};
+
+} // beatmap
+} // livesim
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// love
+#include "common/Exception.h"
+#include "common/Module.h"
+#include "modules/filesystem/Filesystem.h"
+#include "libraries/xxHash/xxhash.h"
+
+// Pack
+#include "../pack/MappedFile.h"
+
+// Beatmap
+#include "BeatmapCache.h"
+#include "FiLiveBeatmap.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+namespace
+{
+
+enum Column
+{
+	COLUMN_TIMES = 0,
+	COLUMN_LENGTHS,
+	COLUMN_GROUPS,
+	COLUMN_COLORS,
+	COLUMN_LANES,
+	COLUMN_EFFECTS,
+	COLUMN_VISIBILITIES,
+	COLUMN_SWINGS,
+	COLUMN_IMAGES,
+	COLUMN_MAX_ENUM
+};
+
+inline size_t align(size_t v)
+{
+	return (v + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+// Returns end of the last column.
+size_t getColumnOffsets(size_t start, size_t count, size_t offsets[COLUMN_MAX_ENUM])
+{
+	size_t offset = start;
+
+	for (int i = 0; i < COLUMN_MAX_ENUM; i++)
+	{
+		offsets[i] = offset = align(offset);
+		offset += count * (i < COLUMN_LANES ? 4 : 1);
+	}
+
+	return offset;
+}
+
+std::string getCacheName(uint64_t hash, size_t difficulty)
+{
+	char name[64];
+	sprintf(name, "%s/%016llx-%u.lsbc", CACHE_DIRECTORY, (unsigned long long) hash, (unsigned int) difficulty);
+	return name;
+}
+
+love::filesystem::Filesystem *getFilesystem()
+{
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+
+	// Without identity, there's no save directory.
+	if (fs == nullptr || *fs->getSaveDirectory() == 0)
+		return nullptr;
+
+	return fs;
+}
+
+void appendString(std::vector<uint8_t> &buffer, const std::string &str)
+{
+	uint32_t len = (uint32_t) str.length();
+	const uint8_t *lenBytes = (const uint8_t *) &len;
+
+	buffer.insert(buffer.end(), lenBytes, lenBytes + 4);
+	buffer.insert(buffer.end(), str.begin(), str.end());
+}
+
+bool readString(const uint8_t *&ptr, const uint8_t *end, std::string &str)
+{
+	uint32_t len;
+
+	if (end - ptr < 4)
+		return false;
+
+	memcpy(&len, ptr, 4);
+	ptr += 4;
+
+	if ((size_t) (end - ptr) < len)
+		return false;
+
+	str.assign((const char *) ptr, len);
+	ptr += len;
+	return true;
+}
+
+} // anonymous
+
+uint64_t hashSource(love::Data *source)
+{
+	return XXH64(source->getData(), source->getSize(), 0);
+}
+
+bool loadCache(uint64_t hash, size_t difficulty, BeatmapInfo &info, Difficulty &diff, NoteTable &notes)
+{
+	auto fs = getFilesystem();
+	if (fs == nullptr)
+		return false;
+
+	std::string path = std::string(fs->getSaveDirectory()) + "/" + getCacheName(hash, difficulty);
+	love::StrongRef<pack::MappedFile> file;
+
+	try
+	{
+		file.set(new pack::MappedFile(path), love::Acquire::NORETAIN);
+	}
+	catch (love::Exception &)
+	{
+		return false;
+	}
+
+	const uint8_t *data = file->getData();
+	size_t size = file->getSize();
+	CacheHeader header;
+
+	if (size < sizeof(CacheHeader))
+		return false;
+
+	memcpy(&header, data, sizeof(CacheHeader));
+	if (memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION)
+		return false;
+	if (header.sourceHash != hash || header.difficulty != difficulty)
+		return false;
+	if (XXH64(data + sizeof(CacheHeader), size - sizeof(CacheHeader), 0) != header.contentHash)
+		return false;
+
+	size_t offsets[COLUMN_MAX_ENUM];
+	size_t stringsEnd = sizeof(CacheHeader) + header.stringsSize;
+	if (stringsEnd > size || header.columnsOffset < stringsEnd || header.columnsOffset > size)
+		return false;
+	if (header.columnCount > size || getColumnOffsets(header.columnsOffset, header.columnCount, offsets) > size)
+		return false;
+
+	const uint8_t *ptr = data + sizeof(CacheHeader);
+	const uint8_t *end = data + stringsEnd;
+	BeatmapInfo newInfo;
+	Difficulty newDiff;
+
+	if (!readString(ptr, end, newInfo.beatmapper) ||
+		!readString(ptr, end, newInfo.songName) ||
+		!readString(ptr, end, newInfo.songInfo) ||
+		!readString(ptr, end, newDiff.name))
+		return false;
+
+	newInfo.background = header.background;
+	newInfo.noteStyle = header.noteStyle;
+	newDiff.star = header.star;
+	newDiff.randomStar = header.randomStar;
+	newDiff.noteCount = header.noteCount;
+	memcpy(newDiff.score, header.score, sizeof(header.score));
+	memcpy(newDiff.combo, header.combo, sizeof(header.combo));
+
+	NoteTable::Columns columns;
+	columns.count = header.columnCount;
+	columns.times = (const float *) (data + offsets[COLUMN_TIMES]);
+	columns.lengths = (const float *) (data + offsets[COLUMN_LENGTHS]);
+	columns.groups = (const uint32_t *) (data + offsets[COLUMN_GROUPS]);
+	columns.colors = (const uint32_t *) (data + offsets[COLUMN_COLORS]);
+	columns.lanes = data + offsets[COLUMN_LANES];
+	columns.effects = data + offsets[COLUMN_EFFECTS];
+	columns.visibilities = data + offsets[COLUMN_VISIBILITIES];
+	columns.swings = data + offsets[COLUMN_SWINGS];
+	columns.images = data + offsets[COLUMN_IMAGES];
+
+	try
+	{
+		notes.set(columns);
+	}
+	catch (love::Exception &)
+	{
+		return false;
+	}
+
+	info = newInfo;
+	diff = newDiff;
+	return true;
+}
+
+bool saveCache(uint64_t hash, size_t difficulty, const BeatmapInfo &info, const Difficulty &diff, const NoteTable &notes)
+{
+	auto fs = getFilesystem();
+	if (fs == nullptr)
+		return false;
+
+	NoteTable::Columns columns = notes.getColumns();
+	std::vector<uint8_t> buffer(sizeof(CacheHeader));
+	CacheHeader header;
+
+	appendString(buffer, info.beatmapper);
+	appendString(buffer, info.songName);
+	appendString(buffer, info.songInfo);
+	appendString(buffer, diff.name);
+
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.magic, CACHE_MAGIC, 4);
+	header.version = CACHE_VERSION;
+	header.sourceHash = hash;
+	header.difficulty = (uint32_t) difficulty;
+	header.noteCount = diff.noteCount;
+	header.columnCount = (uint32_t) columns.count;
+	header.background = info.background;
+	header.noteStyle = info.noteStyle;
+	header.star = diff.star;
+	header.randomStar = diff.randomStar;
+	memcpy(header.score, diff.score, sizeof(header.score));
+	memcpy(header.combo, diff.combo, sizeof(header.combo));
+	header.stringsSize = (uint32_t) (buffer.size() - sizeof(CacheHeader));
+	header.columnsOffset = (uint32_t) align(buffer.size());
+
+	size_t offsets[COLUMN_MAX_ENUM];
+	const void *sources[COLUMN_MAX_ENUM] = {
+		columns.times,
+		columns.lengths,
+		columns.groups,
+		columns.colors,
+		columns.lanes,
+		columns.effects,
+		columns.visibilities,
+		columns.swings,
+		columns.images
+	};
+
+	buffer.resize(getColumnOffsets(header.columnsOffset, columns.count, offsets), 0);
+	for (int i = 0; i < COLUMN_MAX_ENUM; i++)
+	{
+		if (columns.count > 0)
+			memcpy(&buffer[offsets[i]], sources[i], columns.count * (i < COLUMN_LANES ? 4 : 1));
+	}
+
+	header.contentHash = XXH64(&buffer[sizeof(CacheHeader)], buffer.size() - sizeof(CacheHeader), 0);
+	memcpy(&buffer[0], &header, sizeof(CacheHeader));
+
+	try
+	{
+		fs->createDirectory(CACHE_DIRECTORY);
+		fs->write(getCacheName(hash, difficulty).c_str(), buffer.data(), (love::int64) buffer.size());
+	}
+	catch (love::Exception &)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void loadDifficulty(love::Data *source, size_t difficulty, BeatmapInfo &info, Difficulty &diff, NoteTable &notes)
+{
+	uint64_t hash = hashSource(source);
+
+	if (loadCache(hash, difficulty, info, diff, notes))
+		return;
+
+	love::StrongRef<FiLiveBeatmap> beatmap(new FiLiveBeatmap(source), love::Acquire::NORETAIN);
+	std::vector<Note> decoded;
+
+	beatmap->loadNotes(difficulty, decoded);
+	info = beatmap->getInfo();
+	diff = beatmap->getDifficulty(difficulty);
+	notes.set(decoded.empty() ? nullptr : &decoded[0], decoded.size());
+
+	saveCache(hash, difficulty, info, diff, notes);
+}
+
+} // beatmap
+} // livesim
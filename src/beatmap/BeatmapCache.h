@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_BEATMAPCACHE_H
+#define LIVESIM_BEATMAP_BEATMAPCACHE_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+// love
+#include "common/Data.h"
+
+// Beatmap
+#include "Beatmap.h"
+#include "NoteTable.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/*
+ * Cache entry layout. There's one file per difficulty, named
+ * <source hash>-<difficulty>.lsbc, in "beatmapcache" of the save directory.
+ * All integers are little-endian.
+ *
+ * CacheHeader
+ * Strings: beatmapper, song name, song info and difficulty name, each is
+ * uint32 length followed by the data
+ * Note columns, each 16-byte aligned from columnsOffset, in this order:
+ * times, lengths, groups, colors (4 bytes per note), then lanes, effects,
+ * visibilities, swings, images (1 byte per note)
+ *
+ * Columns are stored exactly as NoteTable::getColumns(), so the file can
+ * be mapped and handed to NoteTable::set() directly.
+ */
+
+// Directory in the save directory, also used for other derived data.
+const char CACHE_DIRECTORY[] = "beatmapcache";
+const char CACHE_MAGIC[4] = {'L', 'S', 'B', 'C'};
+const uint32_t CACHE_VERSION = 2;
+const size_t CACHE_ALIGNMENT = 16;
+
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	// XXH64 of the source beatmap file, seed 0
+	uint64_t sourceHash;
+	// XXH64 of everything after this header, seed 0
+	uint64_t contentHash;
+	uint32_t difficulty;
+	// Difficulty::noteCount, which includes notes dropped as invalid
+	uint32_t noteCount;
+	// Rows in the note columns
+	uint32_t columnCount;
+	int32_t background;
+	int32_t noteStyle;
+	int32_t star;
+	int32_t randomStar;
+	uint32_t score[RANK_MAX_ENUM];
+	uint32_t combo[RANK_MAX_ENUM];
+	uint32_t stringsSize;
+	uint32_t columnsOffset;
+};
+
+/**
+ * Compute cache key of beatmap file.
+ *
+ * @param source Beatmap file contents.
+ * @return XXH64 of the contents.
+ */
+uint64_t hashSource(love::Data *source);
+/**
+ * Load difficulty from the cache.
+ *
+ * @param hash Cache key, from hashSource().
+ * @param difficulty Difficulty index.
+ * @param info Where to store song information.
+ * @param diff Where to store difficulty information.
+ * @param notes Where to store the notes.
+ * @return true on cache hit, false if the entry is missing or invalid.
+ */
+bool loadCache(uint64_t hash, size_t difficulty, BeatmapInfo &info, Difficulty &diff, NoteTable &notes);
+/**
+ * Save difficulty to the cache. Requires save directory to be set.
+ *
+ * @return true on success.
+ */
+bool saveCache(uint64_t hash, size_t difficulty, const BeatmapInfo &info, const Difficulty &diff, const NoteTable &notes);
+/**
+ * Load difficulty of FiLive! beatmap, using the cache if possible. On cache
+ * hit, the beatmap isn't parsed nor decompressed at all. On miss, the
+ * decoded difficulty is saved to the cache.
+ *
+ * @param source Beatmap file contents.
+ * @param difficulty Difficulty index.
+ * @param info Where to store song information.
+ * @param diff Where to store difficulty information.
+ * @param notes Where to store the notes.
+ * @throws love::Exception if the beatmap can't be decoded.
+ */
+void loadDifficulty(love::Data *source, size_t difficulty, BeatmapInfo &info, Difficulty &diff, NoteTable &notes);
+
+} // beatmap
+} // livesim
+
+#endif
@@ -0,0 +1,673 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cstring>
+
+// zlib
+#include <zlib.h>
+
+// love
+#include "common/Exception.h"
+
+// FiLiveBeatmap
+#include "FiLiveBeatmap.h"
+
+/*
+ * All multi-byte values are read in native byte order. Like the pack
+ * format, this assumes little-endian host, which is all we target.
+ */
+
+namespace livesim
+{
+namespace beatmap
+{
+
+namespace
+{
+
+/* Bounds-checked reader over uncompressed buffer. */
+class Reader
+{
+public:
+	Reader(const uint8_t *ptr, const uint8_t *end)
+		: ptr(ptr)
+		, end(end)
+	{}
+
+	const uint8_t *skip(size_t size)
+	{
+		if ((size_t) (end - ptr) < size)
+			throw love::Exception("Unexpected end of beatmap data");
+
+		const uint8_t *p = ptr;
+		ptr += size;
+		return p;
+	}
+
+	uint8_t readByte()
+	{
+		return *skip(1);
+	}
+
+	uint32_t readDword()
+	{
+		uint32_t v;
+		memcpy(&v, skip(4), 4);
+		return v;
+	}
+
+	std::string readString()
+	{
+		uint32_t len = readDword();
+		return std::string((const char *) skip(len), len);
+	}
+
+	const uint8_t *ptr;
+	const uint8_t *end;
+};
+
+/* Same interface as Reader, but reads from File. */
+class FileReader
+{
+public:
+	FileReader(love::filesystem::File *file)
+		: file(file)
+	{}
+
+	void read(void *dest, size_t size)
+	{
+		if (file->read(dest, (love::int64) size) != (love::int64) size)
+			throw love::Exception("Unexpected end of beatmap file");
+	}
+
+	// 64-bit, so chunk size plus CRC can't wrap around
+	void skip(uint64_t size)
+	{
+		seek((uint64_t) file->tell() + size);
+	}
+
+	void seek(uint64_t pos)
+	{
+		if (!file->seek((love::uint64) pos))
+			throw love::Exception("Unexpected end of beatmap file");
+	}
+
+	uint64_t tell()
+	{
+		return (uint64_t) file->tell();
+	}
+
+	uint8_t readByte()
+	{
+		uint8_t v;
+		read(&v, 1);
+		return v;
+	}
+
+	uint32_t readDword()
+	{
+		uint32_t v;
+		read(&v, 4);
+		return v;
+	}
+
+	std::string readString()
+	{
+		uint32_t len = readDword();
+		checkRemaining(len);
+
+		std::string str(len, 0);
+		if (len > 0)
+			read(&str[0], len);
+		return str;
+	}
+
+	bool isEOF()
+	{
+		return file->isEOF();
+	}
+
+	// Throws if less than size bytes are left, before allocating for them.
+	void checkRemaining(size_t size)
+	{
+		love::int64 left = file->getSize() - file->tell();
+		if (left < 0 || (love::uint64) left < size)
+			throw love::Exception("Unexpected end of beatmap file");
+	}
+
+private:
+	love::filesystem::File *file;
+};
+
+// Returns the version.
+template<typename R>
+int readHeader(R &reader, BeatmapInfo &info)
+{
+	if (reader.readDword() != FOURCC_HEADER)
+		throw love::Exception("Not a FiLive! beatmap");
+
+	int version = reader.readByte();
+	if (version != 1)
+		throw love::Exception("Unsupported FiLive! beatmap version %d", version);
+
+	info.background = reader.readByte();
+	info.noteStyle = reader.readByte();
+	info.beatmapper = reader.readString();
+	info.songName = reader.readString();
+	info.songInfo = reader.readString();
+	return version;
+}
+
+/*
+ * Reads possibly-compressed chunk payload. Compressed payloads are inflated
+ * straight into the caller's buffer, so there's no intermediate copy of the
+ * whole uncompressed data. The payload is either in memory, or read from
+ * file in small blocks as it's consumed.
+ */
+class PayloadReader
+{
+public:
+	PayloadReader(uint8_t compression, const uint8_t *data, size_t size, size_t uncompressedSize)
+		: compressed(compression != COMPRESSION_NONE)
+		, raw(data, data + size)
+		, file(nullptr)
+		, fileLeft(0)
+		, remaining(uncompressedSize)
+	{
+		initialize(compression, data, size, uncompressedSize);
+	}
+
+	PayloadReader(uint8_t compression, FileReader &file, uint64_t size, size_t uncompressedSize)
+		: compressed(compression != COMPRESSION_NONE)
+		, raw(nullptr, nullptr)
+		, file(&file)
+		, fileLeft(size)
+		, remaining(uncompressedSize)
+	{
+		initialize(compression, nullptr, size, uncompressedSize);
+	}
+
+	~PayloadReader()
+	{
+		if (compressed)
+			inflateEnd(&stream);
+	}
+
+	void read(void *dest, size_t size)
+	{
+		if (size > remaining)
+			throw love::Exception("Beatmap payload is larger than declared");
+
+		remaining -= size;
+
+		if (!compressed)
+		{
+			if (file)
+				file->read(dest, size);
+			else
+				memcpy(dest, raw.skip(size), size);
+			return;
+		}
+
+		stream.next_out = (Bytef *) dest;
+		stream.avail_out = (uInt) size;
+
+		while (stream.avail_out > 0)
+		{
+			if (stream.avail_in == 0 && fileLeft > 0)
+			{
+				size_t block = (size_t) std::min<uint64_t>(fileLeft, sizeof(fileBuffer));
+				file->read(fileBuffer, block);
+				fileLeft -= block;
+				stream.next_in = fileBuffer;
+				stream.avail_in = (uInt) block;
+			}
+
+			int ret = inflate(&stream, Z_SYNC_FLUSH);
+
+			if (ret == Z_STREAM_END && stream.avail_out > 0)
+				throw love::Exception("Unexpected end of compressed beatmap data");
+			else if (ret != Z_OK && ret != Z_STREAM_END)
+				throw love::Exception("Could not decompress beatmap data: %s", stream.msg ? stream.msg : "unknown error");
+		}
+	}
+
+	uint8_t readByte()
+	{
+		uint8_t v;
+		read(&v, 1);
+		return v;
+	}
+
+	uint32_t readDword()
+	{
+		uint32_t v;
+		read(&v, 4);
+		return v;
+	}
+
+	std::string readString()
+	{
+		uint32_t len = readDword();
+		if (len > remaining)
+			throw love::Exception("Beatmap payload is larger than declared");
+
+		std::string str(len, 0);
+		if (len > 0)
+			read(&str[0], len);
+		return str;
+	}
+
+	size_t getRemaining() const
+	{
+		return remaining;
+	}
+
+private:
+	bool compressed;
+	Reader raw;
+	FileReader *file;
+	// Compressed bytes not yet read from file
+	uint64_t fileLeft;
+	uint8_t fileBuffer[512];
+	size_t remaining;
+	z_stream stream;
+
+	// data is null when reading from file
+	void initialize(uint8_t compression, const uint8_t *data, uint64_t size, size_t uncompressedSize)
+	{
+		memset(&stream, 0, sizeof(z_stream));
+
+		if (!compressed)
+		{
+			if (size != uncompressedSize)
+				throw love::Exception("Beatmap payload size mismatch");
+			return;
+		}
+
+		if (compression != COMPRESSION_ZLIB && compression != COMPRESSION_GZIP)
+			throw love::Exception("Unknown beatmap compression %d", (int) compression);
+
+		if (data)
+		{
+			stream.next_in = (Bytef *) data;
+			stream.avail_in = (uInt) size;
+		}
+
+		// 32 to auto-detect zlib or gzip header
+		if (inflateInit2(&stream, 15 + 32) != Z_OK)
+			throw love::Exception("Could not initialize zlib");
+	}
+};
+
+void readDifficultyInfo(PayloadReader &payload, Difficulty &diff)
+{
+	diff.name = payload.readString();
+	diff.star = payload.readByte();
+	diff.randomStar = payload.readByte();
+	if (diff.randomStar == 0)
+		diff.randomStar = diff.star;
+
+	for (int i = 0; i < RANK_MAX_ENUM; i++)
+		diff.score[i] = payload.readDword();
+	for (int i = 0; i < RANK_MAX_ENUM; i++)
+		diff.combo[i] = payload.readDword();
+
+	diff.noteCount = payload.readDword();
+	if (diff.noteCount > payload.getRemaining() / sizeof(Note))
+		throw love::Exception("Beatmap note count is larger than payload");
+}
+
+} // anonymous
+
+FiLiveBeatmap::FiLiveBeatmap(love::Data *data)
+	: data(data)
+	, version(0)
+	, hasNoteStyle(false)
+	, frameNoteStyle(0)
+	, simultaneousNoteStyle(0)
+	, swingNoteStyle(0)
+	, storyboardLength(0)
+{
+	audio.data = storyboard.data = nullptr;
+	audio.size = storyboard.size = 0;
+
+	const uint8_t *ptr = (const uint8_t *) data->getData();
+	const uint8_t *end = ptr + data->getSize();
+
+	parseHeader(ptr, end);
+	parseChunks(ptr, end);
+}
+
+FiLiveBeatmap::~FiLiveBeatmap()
+{}
+
+bool FiLiveBeatmap::isSignature(const void *data, size_t size)
+{
+	uint32_t magic;
+
+	if (size < 4)
+		return false;
+
+	memcpy(&magic, data, 4);
+	return magic == FOURCC_HEADER;
+}
+
+void FiLiveBeatmap::readInfo(love::filesystem::File *file, BeatmapInfo &info, std::vector<Difficulty> &difficulties)
+{
+	FileReader reader(file);
+
+	readHeader(reader, info);
+	difficulties.clear();
+
+	for (;;)
+	{
+		if (reader.isEOF())
+			throw love::Exception("Beatmap is corrupted: missing FEND");
+
+		uint32_t type = reader.readDword();
+		uint32_t size = reader.readDword();
+
+		if (type == FOURCC_FEND)
+			return;
+		else if (type != FOURCC_BMAP)
+		{
+			// Skip data and CRC
+			reader.skip((uint64_t) size + 4);
+			continue;
+		}
+
+		// Compression byte and uncompressed size
+		if (size < 5)
+			throw love::Exception("Unexpected end of beatmap data");
+
+		reader.checkRemaining(size);
+		uint64_t next = reader.tell() + size + 4;
+		uint8_t compression = reader.readByte();
+		uint32_t uncompressedSize = reader.readDword();
+		Difficulty diff;
+
+		{
+			PayloadReader payload(compression, reader, size - 5, uncompressedSize);
+			readDifficultyInfo(payload, diff);
+		}
+
+		difficulties.push_back(diff);
+		reader.seek(next);
+	}
+}
+
+void FiLiveBeatmap::parseHeader(const uint8_t *&ptr, const uint8_t *end)
+{
+	Reader reader(ptr, end);
+
+	version = readHeader(reader, info);
+	ptr = reader.ptr;
+}
+
+void FiLiveBeatmap::parseChunks(const uint8_t *ptr, const uint8_t *end)
+{
+	Reader reader(ptr, end);
+
+	while (reader.ptr < reader.end)
+	{
+		const uint8_t *start = reader.ptr;
+		uint32_t type = reader.readDword();
+		uint32_t size = reader.readDword();
+		Chunk chunk = {reader.skip(size), size};
+		uint32_t crc = reader.readDword();
+		// First letter lowercase means ancillary
+		bool ancillary = (type & 0x20) != 0;
+
+		// Unknown ancillary chunks are skipped without even checking CRC.
+		if (ancillary && type != FOURCC_ADNM && type != FOURCC_ADDT && type != FOURCC_AVNS && type != FOURCC_SRYL)
+			continue;
+
+		// BMAP CRC is checked when its notes are loaded.
+		if (type == FOURCC_BMAP)
+		{
+			parseDifficulty(chunk, start - (const uint8_t *) data->getData(), crc);
+			continue;
+		}
+
+		// CRC covers FourCC, length, and data, which are contiguous.
+		if (crc32(crc32(0L, Z_NULL, 0), start, size + 8) != crc)
+			throw love::Exception("CRC mismatch in beatmap chunk %.4s", (const char *) start);
+
+		if (type == FOURCC_ADNM)
+		{
+			Reader r(chunk.data, chunk.data + chunk.size);
+			audioFilenames.push_back(r.readString());
+		}
+		else if (type == FOURCC_ADDT)
+			parseAudioData(chunk);
+		else if (type == FOURCC_AVNS)
+			parseNoteStyle(chunk);
+		else if (type == FOURCC_SRYL)
+			parseStoryboard(chunk);
+		else if (type == FOURCC_FEND)
+		{
+			if (reader.ptr != reader.end)
+				throw love::Exception("Trailing data after FEND");
+			return;
+		}
+		else
+			throw love::Exception("Unknown critical beatmap chunk %.4s", (const char *) start);
+	}
+
+	throw love::Exception("Beatmap is corrupted: missing FEND");
+}
+
+void FiLiveBeatmap::parseDifficulty(const Chunk &chunk, size_t offset, uint32_t crc)
+{
+	Reader reader(chunk.data, chunk.data + chunk.size);
+	uint8_t compression = reader.readByte();
+	uint32_t uncompressedSize = reader.readDword();
+	// Only inflate as far as the note count.
+	PayloadReader payload(compression, reader.ptr, reader.end - reader.ptr, uncompressedSize);
+	Difficulty diff;
+
+	readDifficultyInfo(payload, diff);
+	difficulties.push_back(diff);
+
+	DifficultyChunk location = {offset, chunk.size, crc};
+	difficultyChunks.push_back(location);
+}
+
+void FiLiveBeatmap::parseAudioData(const Chunk &chunk)
+{
+	if (audio.data != nullptr)
+		throw love::Exception("Beatmap has more than one aDDT chunk");
+
+	Reader reader(chunk.data, chunk.data + chunk.size);
+	audioExtension = reader.readString();
+	audio.size = reader.readDword();
+	audio.data = reader.skip(audio.size);
+}
+
+void FiLiveBeatmap::parseNoteStyle(const Chunk &chunk)
+{
+	Reader reader(chunk.data, chunk.data + chunk.size);
+	frameNoteStyle = reader.readByte();
+	simultaneousNoteStyle = reader.readByte();
+	swingNoteStyle = reader.readByte();
+	hasNoteStyle = true;
+}
+
+void FiLiveBeatmap::parseStoryboard(const Chunk &chunk)
+{
+	Reader reader(chunk.data, chunk.data + chunk.size);
+	storyboardLength = reader.readDword();
+	storyboard.size = reader.readDword();
+	// Compression byte is included in compressed length
+	storyboard.data = reader.skip(storyboard.size);
+
+	if (storyboard.size == 0)
+		throw love::Exception("Invalid storyboard chunk");
+}
+
+int FiLiveBeatmap::getVersion() const
+{
+	return version;
+}
+
+int FiLiveBeatmap::getBackground() const
+{
+	return info.background;
+}
+
+int FiLiveBeatmap::getNoteStyle() const
+{
+	return info.noteStyle;
+}
+
+const std::string &FiLiveBeatmap::getBeatmapper() const
+{
+	return info.beatmapper;
+}
+
+const std::string &FiLiveBeatmap::getSongName() const
+{
+	return info.songName;
+}
+
+const std::string &FiLiveBeatmap::getSongInfo() const
+{
+	return info.songInfo;
+}
+
+const BeatmapInfo &FiLiveBeatmap::getInfo() const
+{
+	return info;
+}
+
+size_t FiLiveBeatmap::getDifficultyCount() const
+{
+	return difficulties.size();
+}
+
+const Difficulty &FiLiveBeatmap::getDifficulty(size_t index) const
+{
+	if (index >= difficulties.size())
+		throw love::Exception("Invalid difficulty index %d", (int) index);
+
+	return difficulties[index];
+}
+
+const std::vector<std::string> &FiLiveBeatmap::getAudioFilenames() const
+{
+	return audioFilenames;
+}
+
+bool FiLiveBeatmap::hasAudioData() const
+{
+	return audio.data != nullptr;
+}
+
+const std::string &FiLiveBeatmap::getAudioExtension() const
+{
+	return audioExtension;
+}
+
+const uint8_t *FiLiveBeatmap::getAudioData(size_t &size) const
+{
+	size = audio.size;
+	return audio.data;
+}
+
+bool FiLiveBeatmap::getAdvancedNoteStyle(int &frame, int &simultaneous, int &swing) const
+{
+	if (!hasNoteStyle)
+		return false;
+
+	frame = frameNoteStyle;
+	simultaneous = simultaneousNoteStyle;
+	swing = swingNoteStyle;
+	return true;
+}
+
+bool FiLiveBeatmap::hasStoryboard() const
+{
+	return storyboard.data != nullptr;
+}
+
+std::string FiLiveBeatmap::getStoryboard() const
+{
+	if (storyboard.data == nullptr)
+		return std::string();
+
+	// Uncompressed storyboard keeps the compression byte in front of it
+	uint8_t compression = storyboard.data[0];
+	const uint8_t *script = storyboard.data;
+	size_t size = storyboard.size;
+	if (compression == COMPRESSION_NONE)
+	{
+		script++;
+		size--;
+	}
+
+	PayloadReader payload(compression, script, size, storyboardLength);
+	std::string result(storyboardLength, 0);
+	if (storyboardLength > 0)
+		payload.read(&result[0], storyboardLength);
+
+	return result;
+}
+
+void FiLiveBeatmap::loadNotes(size_t index, std::vector<Note> &notes) const
+{
+	if (index >= difficulties.size())
+		throw love::Exception("Invalid difficulty index %d", (int) index);
+
+	const DifficultyChunk &location = difficultyChunks[index];
+	const uint8_t *start = (const uint8_t *) data->getData() + location.offset;
+
+	if (crc32(crc32(0L, Z_NULL, 0), start, location.size + 8) != location.crc)
+		throw love::Exception("CRC mismatch in beatmap chunk BMAP");
+
+	Reader reader(start + 8, start + 8 + location.size);
+	uint8_t compression = reader.readByte();
+	uint32_t uncompressedSize = reader.readDword();
+	PayloadReader payload(compression, reader.ptr, reader.end - reader.ptr, uncompressedSize);
+	Difficulty diff;
+
+	readDifficultyInfo(payload, diff);
+	notes.clear();
+
+	if (diff.noteCount > 0)
+	{
+		notes.resize(diff.noteCount);
+		payload.read(&notes[0], diff.noteCount * sizeof(Note));
+		notes.erase(std::remove_if(notes.begin(), notes.end(), [](const Note &n)
+		{
+			return !n.isValid();
+		}), notes.end());
+	}
+}
+
+love::Data *FiLiveBeatmap::getData() const
+{
+	return data.get();
+}
+
+} // beatmap
+} // livesim
@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_FILIVEBEATMAP_H
+#define LIVESIM_BEATMAP_FILIVEBEATMAP_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// love
+#include "common/Data.h"
+#include "common/Object.h"
+#include "modules/filesystem/File.h"
+
+// Beatmap
+#include "Beatmap.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/* Compression of BMAP and sRYL payload */
+enum Compression
+{
+	COMPRESSION_NONE = 0,
+	COMPRESSION_ZLIB = 0x78,
+	COMPRESSION_GZIP = 0x1F
+};
+
+inline uint32_t fourCC(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+const uint32_t FOURCC_HEADER = fourCC('F', 'i', '!', 'M');
+const uint32_t FOURCC_BMAP = fourCC('B', 'M', 'A', 'P');
+const uint32_t FOURCC_ADNM = fourCC('a', 'D', 'N', 'M');
+const uint32_t FOURCC_ADDT = fourCC('a', 'D', 'D', 'T');
+const uint32_t FOURCC_AVNS = fourCC('a', 'V', 'N', 'S');
+const uint32_t FOURCC_SRYL = fourCC('s', 'R', 'Y', 'L');
+const uint32_t FOURCC_FEND = fourCC('F', 'E', 'N', 'D');
+
+/*
+ * FiLive! beatmap (.fim), as described in FiLiveBeatmapSpec.txt.
+ *
+ * Chunks are walked directly over the source Data, which is retained for
+ * the lifetime of this object, so embedded audio and storyboard are never
+ * copied unless asked. Likewise, only the difficulty information of each
+ * BMAP chunk is decoded up front; see loadNotes().
+ */
+class FiLiveBeatmap: public love::Object
+{
+public:
+	/**
+	 * Decode FiLive! beatmap.
+	 *
+	 * @param data Beatmap file contents, e.g. FileData or pack MappedData.
+	 * @throws love::Exception if the beatmap is malformed.
+	 */
+	FiLiveBeatmap(love::Data *data);
+	virtual ~FiLiveBeatmap();
+	/**
+	 * Check whether buffer starts with FiLive! beatmap signature.
+	 *
+	 * @param data Pointer to file contents.
+	 * @param size Size of the file contents.
+	 * @return true if it looks like FiLive! beatmap.
+	 */
+	static bool isSignature(const void *data, size_t size);
+	/**
+	 * Read only song and difficulty information from FiLive! beatmap file.
+	 * Only BMAP chunks are read, and only as far as their note count. Other
+	 * chunks are skipped by seeking, and CRC is not checked.
+	 *
+	 * @param file Opened beatmap file.
+	 * @param info Where to store song information.
+	 * @param difficulties Where to store difficulty information.
+	 * @throws love::Exception if the beatmap is malformed.
+	 */
+	static void readInfo(love::filesystem::File *file, BeatmapInfo &info, std::vector<Difficulty> &difficulties);
+
+	int getVersion() const;
+	int getBackground() const;
+	int getNoteStyle() const;
+	const std::string &getBeatmapper() const;
+	const std::string &getSongName() const;
+	const std::string &getSongInfo() const;
+	const BeatmapInfo &getInfo() const;
+
+	size_t getDifficultyCount() const;
+	/**
+	 * Get difficulty, in the order of BMAP chunks. Only the difficulty
+	 * information is decoded when the beatmap is loaded.
+	 *
+	 * @param index Difficulty index.
+	 * @return Difficulty information.
+	 * @throws love::Exception if index is out of range.
+	 */
+	const Difficulty &getDifficulty(size_t index) const;
+	/**
+	 * Decompress and decode notes of a difficulty. Nothing is cached, so
+	 * call this once, when the difficulty is selected.
+	 *
+	 * @param index Difficulty index.
+	 * @param notes Where to store the valid notes, in file order.
+	 * @throws love::Exception if index is out of range or the BMAP chunk
+	 *         is corrupted.
+	 */
+	void loadNotes(size_t index, std::vector<Note> &notes) const;
+
+	const std::vector<std::string> &getAudioFilenames() const;
+	bool hasAudioData() const;
+	const std::string &getAudioExtension() const;
+	/**
+	 * Get embedded audio, pointing into the source Data.
+	 *
+	 * @param size Where to store the audio size.
+	 * @return Pointer to the audio data, or nullptr if there's none.
+	 */
+	const uint8_t *getAudioData(size_t &size) const;
+
+	/**
+	 * Get advanced note style setting.
+	 *
+	 * @return false if the beatmap doesn't have one.
+	 */
+	bool getAdvancedNoteStyle(int &frame, int &simultaneous, int &swing) const;
+
+	bool hasStoryboard() const;
+	/**
+	 * Get storyboard script, decompressing it if needed.
+	 *
+	 * @return Storyboard script, or empty string if there's none.
+	 * @throws love::Exception if the storyboard can't be decompressed.
+	 */
+	std::string getStoryboard() const;
+
+	love::Data *getData() const;
+
+private:
+	struct Chunk
+	{
+		const uint8_t *data;
+		size_t size;
+	};
+
+	/* BMAP chunk location, for deferred note decoding. */
+	struct DifficultyChunk
+	{
+		// Offset of the chunk FourCC from start of the data.
+		size_t offset;
+		size_t size;
+		uint32_t crc;
+	};
+
+	void parseHeader(const uint8_t *&ptr, const uint8_t *end);
+	void parseChunks(const uint8_t *ptr, const uint8_t *end);
+	void parseDifficulty(const Chunk &chunk, size_t offset, uint32_t crc);
+	void parseAudioData(const Chunk &chunk);
+	void parseNoteStyle(const Chunk &chunk);
+	void parseStoryboard(const Chunk &chunk);
+
+	love::StrongRef<love::Data> data;
+
+	int version;
+	BeatmapInfo info;
+	std::vector<Difficulty> difficulties;
+	std::vector<DifficultyChunk> difficultyChunks;
+
+	std::vector<std::string> audioFilenames;
+	std::string audioExtension;
+	Chunk audio;
+
+	bool hasNoteStyle;
+	int frameNoteStyle;
+	int simultaneousNoteStyle;
+	int swingNoteStyle;
+
+	Chunk storyboard;
+	uint32_t storyboardLength;
+};
+
+} // beatmap
+} // livesim
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <cstring>
+
+// zlib
+#include <zlib.h>
+
+// love
+#include "common/Exception.h"
+#include "modules/data/ByteData.h"
+
+// FiLiveWriter
+#include "FiLiveWriter.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+namespace
+{
+
+/*
+ * Chunk to be written. Its data is head, followed by either the
+ * compressed payload, or meta and then external payload uncompressed.
+ * External payload points to the writer's data, so it's never copied
+ * before the final write.
+ */
+struct Chunk
+{
+	uint32_t type;
+	std::vector<uint8_t> head;
+	std::vector<uint8_t> meta;
+	const void *external;
+	size_t externalSize;
+	Compression compression;
+	std::vector<uint8_t> compressed;
+	std::string error;
+
+	size_t getPayloadSize() const
+	{
+		if (compression != COMPRESSION_NONE)
+			return compressed.size();
+
+		return meta.size() + externalSize;
+	}
+};
+
+void appendBytes(std::vector<uint8_t> &buffer, const void *data, size_t size)
+{
+	const uint8_t *p = (const uint8_t *) data;
+	buffer.insert(buffer.end(), p, p + size);
+}
+
+void appendDword(std::vector<uint8_t> &buffer, uint32_t v)
+{
+	appendBytes(buffer, &v, 4);
+}
+
+void appendString(std::vector<uint8_t> &buffer, const std::string &str)
+{
+	appendDword(buffer, (uint32_t) str.length());
+	appendBytes(buffer, str.data(), str.length());
+}
+
+// Runs on worker thread, so errors are stored instead of thrown.
+void compressChunk(Chunk *chunk)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(z_stream));
+
+	// 16 for gzip header instead of zlib
+	int windowBits = chunk->compression == COMPRESSION_GZIP ? 15 + 16 : 15;
+	if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		chunk->error = "Could not initialize zlib";
+		return;
+	}
+
+	chunk->compressed.resize(deflateBound(&stream, (uLong) (chunk->meta.size() + chunk->externalSize)));
+	stream.next_out = chunk->compressed.data();
+	stream.avail_out = (uInt) chunk->compressed.size();
+
+	// Compress meta then external payload as one stream, without joining them.
+	int ret = Z_OK;
+	if (!chunk->meta.empty())
+	{
+		stream.next_in = chunk->meta.data();
+		stream.avail_in = (uInt) chunk->meta.size();
+		ret = deflate(&stream, Z_NO_FLUSH);
+	}
+
+	if (ret == Z_OK)
+	{
+		stream.next_in = (Bytef *) chunk->external;
+		stream.avail_in = (uInt) chunk->externalSize;
+		ret = deflate(&stream, Z_FINISH);
+	}
+
+	if (ret != Z_STREAM_END)
+		chunk->error = stream.msg ? stream.msg : "Could not compress beatmap chunk";
+	else
+		chunk->compressed.resize(stream.total_out);
+
+	deflateEnd(&stream);
+}
+
+uint8_t *writeBytes(uint8_t *out, const void *data, size_t size)
+{
+	if (size > 0)
+		memcpy(out, data, size);
+
+	return out + size;
+}
+
+uint8_t *writeDword(uint8_t *out, uint32_t v)
+{
+	return writeBytes(out, &v, 4);
+}
+
+uint8_t *writeString(uint8_t *out, const std::string &str)
+{
+	out = writeDword(out, (uint32_t) str.length());
+	return writeBytes(out, str.data(), str.length());
+}
+
+} // anonymous
+
+FiLiveWriter::FiLiveWriter(const BeatmapInfo &info)
+	: info(info)
+	, hasNoteStyle(false)
+	, hasStoryboard(false)
+	, storyboardCompression(COMPRESSION_NONE)
+{
+	noteStyles[0] = noteStyles[1] = noteStyles[2] = 0;
+}
+
+FiLiveWriter::~FiLiveWriter()
+{}
+
+void FiLiveWriter::addDifficulty(const Difficulty &diff, const std::vector<Note> &notes, Compression compression)
+{
+	DifficultyData data;
+	data.info = diff;
+	data.notes = notes;
+	data.compression = compression;
+	difficulties.push_back(data);
+}
+
+void FiLiveWriter::addAudioFilename(const std::string &filename)
+{
+	audioFilenames.push_back(filename);
+}
+
+void FiLiveWriter::setAudioData(const std::string &extension, love::Data *data)
+{
+	audioExtension = extension;
+	audioData.set(data);
+}
+
+void FiLiveWriter::setAdvancedNoteStyle(int frame, int simultaneous, int swing)
+{
+	hasNoteStyle = true;
+	noteStyles[0] = (uint8_t) frame;
+	noteStyles[1] = (uint8_t) simultaneous;
+	noteStyles[2] = (uint8_t) swing;
+}
+
+void FiLiveWriter::setStoryboard(const std::string &script, Compression compression)
+{
+	hasStoryboard = true;
+	storyboard = script;
+	storyboardCompression = compression;
+}
+
+love::Data *FiLiveWriter::encode(base::ThreadPool *pool) const
+{
+	// Sized up front, so pointers to chunks stay valid for compression jobs.
+	size_t chunkCount = difficulties.size() + audioFilenames.size() + 4;
+	std::vector<Chunk> chunks(chunkCount);
+	size_t count = 0;
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].external = nullptr;
+		chunks[i].externalSize = 0;
+		chunks[i].compression = COMPRESSION_NONE;
+	}
+
+	for (const DifficultyData &diff: difficulties)
+	{
+		Chunk &chunk = chunks[count++];
+		chunk.type = FOURCC_BMAP;
+		chunk.compression = diff.compression;
+
+		appendString(chunk.meta, diff.info.name);
+		chunk.meta.push_back((uint8_t) diff.info.star);
+		chunk.meta.push_back((uint8_t) (diff.info.randomStar == diff.info.star ? 0 : diff.info.randomStar));
+		appendBytes(chunk.meta, diff.info.score, sizeof(diff.info.score));
+		appendBytes(chunk.meta, diff.info.combo, sizeof(diff.info.combo));
+		appendDword(chunk.meta, (uint32_t) diff.notes.size());
+
+		chunk.external = diff.notes.data();
+		chunk.externalSize = diff.notes.size() * sizeof(Note);
+
+		chunk.head.push_back((uint8_t) diff.compression);
+		appendDword(chunk.head, (uint32_t) (chunk.meta.size() + chunk.externalSize));
+	}
+
+	for (const std::string &filename: audioFilenames)
+	{
+		Chunk &chunk = chunks[count++];
+		chunk.type = FOURCC_ADNM;
+		appendString(chunk.meta, filename);
+	}
+
+	if (audioData.get())
+	{
+		Chunk &chunk = chunks[count++];
+		chunk.type = FOURCC_ADDT;
+		appendString(chunk.head, audioExtension);
+		appendDword(chunk.head, (uint32_t) audioData->getSize());
+		chunk.external = audioData->getData();
+		chunk.externalSize = audioData->getSize();
+	}
+
+	if (hasNoteStyle)
+	{
+		Chunk &chunk = chunks[count++];
+		chunk.type = FOURCC_AVNS;
+		appendBytes(chunk.meta, noteStyles, 3);
+	}
+
+	// Head is written after compression, as it has the compressed size.
+	Chunk *storyboardChunk = nullptr;
+	if (hasStoryboard)
+	{
+		storyboardChunk = &chunks[count++];
+		storyboardChunk->type = FOURCC_SRYL;
+		storyboardChunk->compression = storyboardCompression;
+		storyboardChunk->external = storyboard.data();
+		storyboardChunk->externalSize = storyboard.length();
+	}
+
+	chunks[count++].type = FOURCC_FEND;
+	chunks.resize(count);
+
+	for (Chunk &chunk: chunks)
+	{
+		if (chunk.compression == COMPRESSION_NONE)
+			continue;
+
+		Chunk *c = &chunk;
+		if (pool)
+			pool->submit([c]() { compressChunk(c); });
+		else
+			compressChunk(c);
+	}
+
+	if (pool)
+		pool->wait();
+
+	for (const Chunk &chunk: chunks)
+	{
+		if (!chunk.error.empty())
+			throw love::Exception("Could not compress beatmap: %s", chunk.error.c_str());
+	}
+
+	if (storyboardChunk)
+	{
+		std::vector<uint8_t> &head = storyboardChunk->head;
+		appendDword(head, (uint32_t) storyboard.length());
+
+		// Compressed stream starts with its own compression byte.
+		if (storyboardChunk->compression == COMPRESSION_NONE)
+		{
+			appendDword(head, (uint32_t) storyboard.length() + 1);
+			head.push_back(COMPRESSION_NONE);
+		}
+		else
+			appendDword(head, (uint32_t) storyboardChunk->compressed.size());
+	}
+
+	size_t size = 7 + 12 + info.beatmapper.length() + info.songName.length() + info.songInfo.length();
+	for (const Chunk &chunk: chunks)
+		size += 12 + chunk.head.size() + chunk.getPayloadSize();
+
+	love::StrongRef<love::data::ByteData> output(new love::data::ByteData(size), love::Acquire::NORETAIN);
+	uint8_t *out = (uint8_t *) output->getData();
+
+	out = writeDword(out, FOURCC_HEADER);
+	*out++ = 1;
+	*out++ = (uint8_t) info.background;
+	*out++ = (uint8_t) info.noteStyle;
+	out = writeString(out, info.beatmapper);
+	out = writeString(out, info.songName);
+	out = writeString(out, info.songInfo);
+
+	for (const Chunk &chunk: chunks)
+	{
+		uint8_t *start = out;
+		size_t chunkSize = chunk.head.size() + chunk.getPayloadSize();
+
+		out = writeDword(out, chunk.type);
+		out = writeDword(out, (uint32_t) chunkSize);
+		out = writeBytes(out, chunk.head.data(), chunk.head.size());
+
+		if (chunk.compression != COMPRESSION_NONE)
+			out = writeBytes(out, chunk.compressed.data(), chunk.compressed.size());
+		else
+		{
+			out = writeBytes(out, chunk.meta.data(), chunk.meta.size());
+			out = writeBytes(out, chunk.external, chunk.externalSize);
+		}
+
+		// CRC of the chunk as written, without copying it elsewhere.
+		out = writeDword(out, (uint32_t) crc32(crc32(0L, Z_NULL, 0), start, (uInt) (chunkSize + 8)));
+	}
+
+	output->retain();
+	return output.get();
+}
+
+} // beatmap
+} // livesim
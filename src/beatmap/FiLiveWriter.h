@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_FILIVEWRITER_H
+#define LIVESIM_BEATMAP_FILIVEWRITER_H
+
+// std
+#include <string>
+#include <vector>
+
+// love
+#include "common/Data.h"
+#include "common/Object.h"
+
+// ThreadPool
+#include "../ThreadPool.h"
+
+// Beatmap
+#include "Beatmap.h"
+#include "FiLiveBeatmap.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/*
+ * Encodes FiLive! beatmap (.fim). Chunks are written in the order: BMAP
+ * (in the order they're added), aDNM, aDDT, aVNS, sRYL, FEND.
+ */
+class FiLiveWriter
+{
+public:
+	FiLiveWriter(const BeatmapInfo &info);
+	~FiLiveWriter();
+	/**
+	 * Add difficulty. Its noteCount is ignored.
+	 *
+	 * @param diff Difficulty information.
+	 * @param notes Notes of the difficulty, copied.
+	 * @param compression Compression of the BMAP payload.
+	 */
+	void addDifficulty(const Difficulty &diff, const std::vector<Note> &notes, Compression compression = COMPRESSION_ZLIB);
+	void addAudioFilename(const std::string &filename);
+	/**
+	 * Embed audio. The data is retained, not copied, until encode().
+	 *
+	 * @param extension Audio extension, e.g. "ogg".
+	 * @param data Audio file contents.
+	 */
+	void setAudioData(const std::string &extension, love::Data *data);
+	void setAdvancedNoteStyle(int frame, int simultaneous, int swing);
+	void setStoryboard(const std::string &script, Compression compression = COMPRESSION_ZLIB);
+	/**
+	 * Encode the beatmap. Compressed chunks are compressed concurrently, then
+	 * every chunk is written straight into the output, which is allocated
+	 * once.
+	 *
+	 * @param pool Thread pool used for compression, or nullptr to compress
+	 *        on the calling thread. This waits for all its jobs.
+	 * @return New Data containing the beatmap file.
+	 * @throws love::Exception if compression fails.
+	 */
+	love::Data *encode(base::ThreadPool *pool = nullptr) const;
+
+private:
+	struct DifficultyData
+	{
+		Difficulty info;
+		std::vector<Note> notes;
+		Compression compression;
+	};
+
+	BeatmapInfo info;
+	std::vector<DifficultyData> difficulties;
+	std::vector<std::string> audioFilenames;
+	std::string audioExtension;
+	love::StrongRef<love::Data> audioData;
+	bool hasNoteStyle;
+	uint8_t noteStyles[3];
+	bool hasStoryboard;
+	std::string storyboard;
+	Compression storyboardCompression;
+};
+
+} // beatmap
+} // livesim
+
+#endif
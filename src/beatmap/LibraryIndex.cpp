@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cstring>
+
+// love
+#include "common/Exception.h"
+#include "common/Module.h"
+#include "modules/filesystem/Filesystem.h"
+#include "libraries/xxHash/xxhash.h"
+
+// Beatmap
+#include "FiLiveBeatmap.h"
+#include "LibraryIndex.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+namespace
+{
+
+class IndexWriter
+{
+public:
+	void write(const void *data, size_t size)
+	{
+		const uint8_t *p = (const uint8_t *) data;
+		buffer.insert(buffer.end(), p, p + size);
+	}
+
+	template<typename T>
+	void write(T v)
+	{
+		write(&v, sizeof(T));
+	}
+
+	void writeString(const std::string &str)
+	{
+		write((uint32_t) str.length());
+		write(str.data(), str.length());
+	}
+
+	std::vector<uint8_t> buffer;
+};
+
+class IndexReader
+{
+public:
+	IndexReader(const uint8_t *ptr, const uint8_t *end)
+		: ptr(ptr)
+		, end(end)
+	{}
+
+	void read(void *dest, size_t size)
+	{
+		if ((size_t) (end - ptr) < size)
+			throw love::Exception("Unexpected end of library index");
+
+		memcpy(dest, ptr, size);
+		ptr += size;
+	}
+
+	template<typename T>
+	T read()
+	{
+		T v;
+		read(&v, sizeof(T));
+		return v;
+	}
+
+	std::string readString()
+	{
+		uint32_t len = read<uint32_t>();
+		if ((size_t) (end - ptr) < len)
+			throw love::Exception("Unexpected end of library index");
+
+		std::string str((const char *) ptr, len);
+		ptr += len;
+		return str;
+	}
+
+	const uint8_t *ptr;
+	const uint8_t *end;
+};
+
+love::filesystem::Filesystem *getFilesystem()
+{
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+	if (fs == nullptr)
+		throw love::Exception("love.filesystem is not loaded");
+
+	return fs;
+}
+
+bool isBeatmapFile(const std::string &name)
+{
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos)
+		return false;
+
+	std::string ext = name.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == "fim" || ext == "fi" || ext == "flm";
+}
+
+void scanDirectory(love::filesystem::Filesystem *fs, const std::string &directory, std::vector<LibraryEntry> &files)
+{
+	std::vector<std::string> items;
+	fs->getDirectoryItems(directory.c_str(), items);
+
+	for (const std::string &item: items)
+	{
+		std::string path = directory.empty() ? item : directory + "/" + item;
+		love::filesystem::Filesystem::Info info;
+
+		if (!fs->getInfo(path.c_str(), info))
+			continue;
+
+		if (info.type == love::filesystem::Filesystem::FILETYPE_DIRECTORY)
+			scanDirectory(fs, path, files);
+		else if (info.type == love::filesystem::Filesystem::FILETYPE_FILE && isBeatmapFile(item))
+		{
+			LibraryEntry entry;
+			entry.path = path;
+			entry.modtime = info.modtime;
+			entry.size = info.size;
+			entry.valid = false;
+			files.push_back(entry);
+		}
+	}
+}
+
+void readEntry(love::filesystem::Filesystem *fs, LibraryEntry &entry)
+{
+	try
+	{
+		love::StrongRef<love::filesystem::File> file(fs->newFile(entry.path.c_str()), love::Acquire::NORETAIN);
+		file->open(love::filesystem::File::MODE_READ);
+		FiLiveBeatmap::readInfo(file, entry.info, entry.difficulties);
+		entry.valid = true;
+	}
+	catch (love::Exception &)
+	{
+		entry.valid = false;
+		entry.info = BeatmapInfo();
+		entry.difficulties.clear();
+	}
+}
+
+inline bool comparePath(const LibraryEntry &entry, const std::string &path)
+{
+	return entry.path < path;
+}
+
+} // anonymous
+
+LibraryIndex::LibraryIndex(const std::string &filename)
+	: filename(filename)
+{}
+
+bool LibraryIndex::load()
+{
+	auto fs = getFilesystem();
+	std::vector<LibraryEntry> loaded;
+
+	entries.clear();
+
+	try
+	{
+		love::StrongRef<love::filesystem::FileData> data(fs->read(filename.c_str()), love::Acquire::NORETAIN);
+		const uint8_t *ptr = (const uint8_t *) data->getData();
+		size_t size = data->getSize();
+		IndexHeader header;
+
+		if (size < sizeof(IndexHeader))
+			return false;
+
+		memcpy(&header, ptr, sizeof(IndexHeader));
+		if (memcmp(header.magic, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION)
+			return false;
+		if (XXH64(ptr + sizeof(IndexHeader), size - sizeof(IndexHeader), 0) != header.contentHash)
+			return false;
+
+		IndexReader reader(ptr + sizeof(IndexHeader), ptr + size);
+		loaded.resize(header.entryCount > size ? 0 : header.entryCount);
+
+		for (LibraryEntry &entry: loaded)
+		{
+			entry.path = reader.readString();
+			entry.modtime = reader.read<int64_t>();
+			entry.size = reader.read<int64_t>();
+			entry.valid = reader.read<uint8_t>() != 0;
+			entry.info.beatmapper = reader.readString();
+			entry.info.songName = reader.readString();
+			entry.info.songInfo = reader.readString();
+			entry.info.background = reader.read<uint8_t>();
+			entry.info.noteStyle = reader.read<uint8_t>();
+
+			uint32_t count = reader.read<uint32_t>();
+			if (count > size)
+				return false;
+
+			entry.difficulties.resize(count);
+			for (Difficulty &diff: entry.difficulties)
+			{
+				diff.name = reader.readString();
+				diff.star = reader.read<uint8_t>();
+				diff.randomStar = reader.read<uint8_t>();
+				reader.read(diff.score, sizeof(diff.score));
+				reader.read(diff.combo, sizeof(diff.combo));
+				diff.noteCount = reader.read<uint32_t>();
+			}
+		}
+	}
+	catch (love::Exception &)
+	{
+		return false;
+	}
+
+	entries.swap(loaded);
+	return true;
+}
+
+bool LibraryIndex::save() const
+{
+	auto fs = getFilesystem();
+	IndexWriter writer;
+	IndexHeader header;
+
+	writer.buffer.resize(sizeof(IndexHeader));
+
+	for (const LibraryEntry &entry: entries)
+	{
+		writer.writeString(entry.path);
+		writer.write<int64_t>(entry.modtime);
+		writer.write<int64_t>(entry.size);
+		writer.write<uint8_t>(entry.valid ? 1 : 0);
+		writer.writeString(entry.info.beatmapper);
+		writer.writeString(entry.info.songName);
+		writer.writeString(entry.info.songInfo);
+		writer.write<uint8_t>((uint8_t) entry.info.background);
+		writer.write<uint8_t>((uint8_t) entry.info.noteStyle);
+		writer.write<uint32_t>((uint32_t) entry.difficulties.size());
+
+		for (const Difficulty &diff: entry.difficulties)
+		{
+			writer.writeString(diff.name);
+			writer.write<uint8_t>((uint8_t) diff.star);
+			writer.write<uint8_t>((uint8_t) diff.randomStar);
+			writer.write(diff.score, sizeof(diff.score));
+			writer.write(diff.combo, sizeof(diff.combo));
+			writer.write<uint32_t>(diff.noteCount);
+		}
+	}
+
+	std::vector<uint8_t> &buffer = writer.buffer;
+	memset(&header, 0, sizeof(IndexHeader));
+	memcpy(header.magic, INDEX_MAGIC, 4);
+	header.version = INDEX_VERSION;
+	header.entryCount = (uint32_t) entries.size();
+	header.contentHash = XXH64(&buffer[sizeof(IndexHeader)], buffer.size() - sizeof(IndexHeader), 0);
+	memcpy(&buffer[0], &header, sizeof(IndexHeader));
+
+	try
+	{
+		fs->write(filename.c_str(), buffer.data(), (love::int64) buffer.size());
+	}
+	catch (love::Exception &)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+size_t LibraryIndex::update(const std::string &directory, base::ThreadPool &pool)
+{
+	auto fs = getFilesystem();
+	std::vector<LibraryEntry> files;
+	size_t readCount = 0;
+
+	scanDirectory(fs, directory, files);
+	std::sort(files.begin(), files.end(), [](const LibraryEntry &a, const LibraryEntry &b)
+	{
+		return a.path < b.path;
+	});
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		LibraryEntry &entry = files[i];
+		const LibraryEntry *old = find(entry.path);
+
+		if (old && old->modtime == entry.modtime && old->size == entry.size)
+		{
+			entry = *old;
+			continue;
+		}
+
+		// Each job only touches its own entry.
+		LibraryEntry *target = &entry;
+		pool.submit([fs, target]()
+		{
+			readEntry(fs, *target);
+		});
+		readCount++;
+	}
+
+	pool.wait();
+	entries.swap(files);
+	return readCount;
+}
+
+const std::vector<LibraryEntry> &LibraryIndex::getEntries() const
+{
+	return entries;
+}
+
+const LibraryEntry *LibraryIndex::find(const std::string &path) const
+{
+	std::vector<LibraryEntry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), path, comparePath);
+
+	if (it == entries.end() || it->path != path)
+		return nullptr;
+
+	return &*it;
+}
+
+} // beatmap
+} // livesim
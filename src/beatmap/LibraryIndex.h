@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_LIBRARYINDEX_H
+#define LIVESIM_BEATMAP_LIBRARYINDEX_H
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ThreadPool
+#include "../ThreadPool.h"
+
+// Beatmap
+#include "Beatmap.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/*
+ * Index file layout, all integers are little-endian. Strings are uint32
+ * length followed by the data.
+ *
+ * IndexHeader
+ * For each entry, sorted by path:
+ *   string path, int64 modtime, int64 size, uint8 valid
+ *   string beatmapper, string song name, string song info
+ *   uint8 background, uint8 note style, uint32 difficulty count
+ *   For each difficulty:
+ *     string name, uint8 star, uint8 random star
+ *     uint32 score[4], uint32 combo[4], uint32 note count
+ */
+
+const char INDEX_MAGIC[4] = {'L', 'S', 'B', 'I'};
+const uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	// XXH64 of everything after this header, seed 0
+	uint64_t contentHash;
+};
+
+struct LibraryEntry
+{
+	// Path in love.filesystem
+	std::string path;
+	int64_t modtime;
+	int64_t size;
+	// False if the beatmap can't be read. Kept so it's not retried until it changes.
+	bool valid;
+	BeatmapInfo info;
+	std::vector<Difficulty> difficulties;
+};
+
+/*
+ * Song and difficulty information of every beatmap in the song library,
+ * without any note data.
+ */
+class LibraryIndex
+{
+public:
+	/**
+	 * Create empty library index.
+	 *
+	 * @param filename Index file name in the save directory.
+	 */
+	LibraryIndex(const std::string &filename = "beatmapindex.lsbi");
+	/**
+	 * Load index from the save directory.
+	 *
+	 * @return false if the index is missing or invalid, in which case the
+	 *         index is left empty.
+	 */
+	bool load();
+	/**
+	 * Save index to the save directory.
+	 *
+	 * @return true on success.
+	 */
+	bool save() const;
+	/**
+	 * Scan directory recursively for FiLive! beatmaps and update the index.
+	 * Beatmaps whose modification time and size didn't change are not read
+	 * again. The rest are read in parallel, and only their header and BMAP
+	 * chunks are read.
+	 *
+	 * @param directory Directory in love.filesystem.
+	 * @param pool Thread pool to read beatmaps in. This waits for all its jobs.
+	 * @return Amount of beatmaps read.
+	 * @throws love::Exception if love.filesystem is not loaded.
+	 */
+	size_t update(const std::string &directory, base::ThreadPool &pool);
+	/**
+	 * Get all entries, sorted by path.
+	 *
+	 * @return Index entries.
+	 */
+	const std::vector<LibraryEntry> &getEntries() const;
+	/**
+	 * Find entry by path, in O(log n).
+	 *
+	 * @param path Beatmap path.
+	 * @return Entry, or nullptr if it's not in the index.
+	 */
+	const LibraryEntry *find(const std::string &path) const;
+
+private:
+	std::string filename;
+	std::vector<LibraryEntry> entries;
+};
+
+} // beatmap
+} // livesim
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+
+// love
+#include "common/Exception.h"
+
+// NoteTable
+#include "NoteTable.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+namespace
+{
+
+inline void checkLane(int lane)
+{
+	if (lane < 0 || lane >= NoteTable::LANE_COUNT)
+		throw love::Exception("Invalid lane %d", lane);
+}
+
+} // anonymous
+
+NoteTable::NoteTable()
+{
+	resetJudgement();
+}
+
+NoteTable::NoteTable(const std::vector<Note> &notes)
+{
+	set(notes.empty() ? nullptr : &notes[0], notes.size());
+}
+
+void NoteTable::set(const Note *notes, size_t count)
+{
+	std::vector<uint32_t> order(count);
+
+	for (size_t i = 0; i < count; i++)
+		order[i] = (uint32_t) i;
+
+	std::stable_sort(order.begin(), order.end(), [notes](uint32_t a, uint32_t b)
+	{
+		return notes[a].time < notes[b].time;
+	});
+
+	times.resize(count);
+	lengths.resize(count);
+	lanes.resize(count);
+	effects.resize(count);
+	visibilities.resize(count);
+	swings.resize(count);
+	groups.resize(count);
+	images.resize(count);
+	colors.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Note &note = notes[order[i]];
+		Note::Effect effect = note.getEffect();
+		int r, g, b;
+
+		times[i] = note.time;
+		lengths[i] = effect == Note::EFFECT_LONG ? note.length : 0.0f;
+		lanes[i] = (uint8_t) (note.getPosition() - 1);
+		effects[i] = (uint8_t) effect;
+		visibilities[i] = (uint8_t) note.getVisibility();
+		swings[i] = note.isSwing() ? 1 : 0;
+		groups[i] = note.getGroup();
+		images[i] = (uint8_t) note.getImage();
+		note.getColor(r, g, b);
+		colors[i] = (uint32_t(r) << 18) | (uint32_t(g) << 9) | uint32_t(b);
+	}
+
+	buildIndices();
+}
+
+void NoteTable::set(const Columns &columns)
+{
+	size_t count = columns.count;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (columns.lanes[i] >= LANE_COUNT)
+			throw love::Exception("Invalid lane %d", (int) columns.lanes[i]);
+	}
+
+	times.assign(columns.times, columns.times + count);
+	lengths.assign(columns.lengths, columns.lengths + count);
+	lanes.assign(columns.lanes, columns.lanes + count);
+	effects.assign(columns.effects, columns.effects + count);
+	visibilities.assign(columns.visibilities, columns.visibilities + count);
+	swings.assign(columns.swings, columns.swings + count);
+	groups.assign(columns.groups, columns.groups + count);
+	images.assign(columns.images, columns.images + count);
+	colors.assign(columns.colors, columns.colors + count);
+
+	buildIndices();
+}
+
+NoteTable::Columns NoteTable::getColumns() const
+{
+	Columns columns = {
+		times.size(),
+		times.data(),
+		lengths.data(),
+		lanes.data(),
+		effects.data(),
+		visibilities.data(),
+		swings.data(),
+		groups.data(),
+		images.data(),
+		colors.data()
+	};
+
+	return columns;
+}
+
+void NoteTable::buildIndices()
+{
+	size_t count = times.size();
+	float maxEnd = -INFINITY;
+
+	endTimes.resize(count);
+	maxEndTimes.resize(count);
+
+	for (int i = 0; i < LANE_COUNT; i++)
+		laneNotes[i].clear();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		endTimes[i] = times[i] + lengths[i];
+		maxEnd = std::max(maxEnd, endTimes[i]);
+		maxEndTimes[i] = maxEnd;
+		laneNotes[lanes[i]].push_back((uint32_t) i);
+	}
+
+	resetJudgement();
+}
+
+size_t NoteTable::size() const
+{
+	return times.size();
+}
+
+const float *NoteTable::getTimes() const
+{
+	return times.data();
+}
+
+const float *NoteTable::getLengths() const
+{
+	return lengths.data();
+}
+
+const float *NoteTable::getEndTimes() const
+{
+	return endTimes.data();
+}
+
+const uint8_t *NoteTable::getLanes() const
+{
+	return lanes.data();
+}
+
+const uint8_t *NoteTable::getEffects() const
+{
+	return effects.data();
+}
+
+const uint8_t *NoteTable::getVisibilities() const
+{
+	return visibilities.data();
+}
+
+const uint8_t *NoteTable::getSwings() const
+{
+	return swings.data();
+}
+
+const uint32_t *NoteTable::getGroups() const
+{
+	return groups.data();
+}
+
+const uint8_t *NoteTable::getImages() const
+{
+	return images.data();
+}
+
+const uint32_t *NoteTable::getColors() const
+{
+	return colors.data();
+}
+
+const std::vector<uint32_t> &NoteTable::getLaneNotes(int lane) const
+{
+	checkLane(lane);
+	return laneNotes[lane];
+}
+
+void NoteTable::getVisibleRange(double time, double approach, size_t &first, size_t &last) const
+{
+	// Any note which ends at or after time is at or after this one.
+	first = std::lower_bound(maxEndTimes.begin(), maxEndTimes.end(), (float) time) - maxEndTimes.begin();
+	last = std::upper_bound(times.begin(), times.end(), (float) (time + approach)) - times.begin();
+
+	if (last < first)
+		last = first;
+}
+
+size_t NoteTable::findLaneNote(int lane, double time) const
+{
+	checkLane(lane);
+
+	const std::vector<uint32_t> &indices = laneNotes[lane];
+	const std::vector<float> &t = times;
+	std::vector<uint32_t>::const_iterator it = std::lower_bound(indices.begin(), indices.end(), (float) time, [&t](uint32_t index, float value)
+	{
+		return t[index] < value;
+	});
+
+	return it == indices.end() ? NONE : *it;
+}
+
+size_t NoteTable::getNextUnjudged(int lane)
+{
+	checkLane(lane);
+
+	const std::vector<uint32_t> &indices = laneNotes[lane];
+	size_t &cursor = laneCursors[lane];
+
+	while (cursor < indices.size() && judged[indices[cursor]])
+		cursor++;
+
+	return cursor < indices.size() ? indices[cursor] : NONE;
+}
+
+void NoteTable::setJudged(size_t index)
+{
+	if (index >= judged.size())
+		throw love::Exception("Invalid note index %d", (int) index);
+
+	judged[index] = 1;
+}
+
+bool NoteTable::isJudged(size_t index) const
+{
+	return index < judged.size() && judged[index] != 0;
+}
+
+void NoteTable::resetJudgement()
+{
+	judged.assign(times.size(), 0);
+
+	for (int i = 0; i < LANE_COUNT; i++)
+		laneCursors[i] = 0;
+}
+
+} // beatmap
+} // livesim
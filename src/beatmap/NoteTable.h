@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_BEATMAP_NOTETABLE_H
+#define LIVESIM_BEATMAP_NOTETABLE_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Beatmap
+#include "Beatmap.h"
+
+namespace livesim
+{
+namespace beatmap
+{
+
+/*
+ * Notes of one difficulty, unpacked into per-field arrays sorted by time.
+ * Lane index is position - 1, so lane 0 is the rightmost and lane 8 is the
+ * leftmost. Notes with the same timing keep their file order.
+ */
+class NoteTable
+{
+public:
+	static const int LANE_COUNT = 9;
+	static const size_t NONE = (size_t) -1;
+
+	/* Pointers to the per-field arrays, count elements each. */
+	struct Columns
+	{
+		size_t count;
+		const float *times;
+		const float *lengths;
+		const uint8_t *lanes;
+		const uint8_t *effects;
+		const uint8_t *visibilities;
+		const uint8_t *swings;
+		const uint32_t *groups;
+		const uint8_t *images;
+		const uint32_t *colors;
+	};
+
+	NoteTable();
+	/**
+	 * Build note table.
+	 *
+	 * @param notes Valid notes, in any order.
+	 */
+	NoteTable(const std::vector<Note> &notes);
+	/**
+	 * Replace the table contents and reset judgement state.
+	 *
+	 * @param notes Pointer to valid notes, in any order.
+	 * @param count Amount of notes.
+	 */
+	void set(const Note *notes, size_t count);
+	/**
+	 * Replace the table contents with already unpacked and sorted arrays,
+	 * e.g. from beatmap cache, and reset judgement state.
+	 *
+	 * @param columns Arrays, as returned by getColumns().
+	 * @throws love::Exception if lane is out of range.
+	 */
+	void set(const Columns &columns);
+	Columns getColumns() const;
+	size_t size() const;
+
+	/* Per-field arrays, size() elements each. */
+	const float *getTimes() const;
+	// Long note length, 0 for other notes
+	const float *getLengths() const;
+	// Time + length, which is the time the note must be judged.
+	const float *getEndTimes() const;
+	const uint8_t *getLanes() const;
+	const uint8_t *getEffects() const;
+	const uint8_t *getVisibilities() const;
+	const uint8_t *getSwings() const;
+	const uint32_t *getGroups() const;
+	const uint8_t *getImages() const;
+	// Packed 9-bit color components: r << 18 | g << 9 | b
+	const uint32_t *getColors() const;
+
+	/**
+	 * Get indices of notes in a lane, sorted by time.
+	 *
+	 * @param lane Lane index, 0 to LANE_COUNT - 1.
+	 * @return Note indices.
+	 */
+	const std::vector<uint32_t> &getLaneNotes(int lane) const;
+
+	/**
+	 * Find notes which may be visible in [time, time + approach], in
+	 * O(log n). The range includes long notes which started before time but
+	 * haven't ended yet. It may also include some notes which already ended,
+	 * so the caller still checks getEndTimes().
+	 *
+	 * @param time Current time.
+	 * @param approach How far ahead notes are visible.
+	 * @param first Where to store first index of the range.
+	 * @param last Where to store one past last index of the range.
+	 */
+	void getVisibleRange(double time, double approach, size_t &first, size_t &last) const;
+	/**
+	 * Find first note in a lane at or after time, in O(log n).
+	 *
+	 * @param lane Lane index.
+	 * @param time Time to search from.
+	 * @return Note index, or NONE.
+	 */
+	size_t findLaneNote(int lane, double time) const;
+
+	/**
+	 * Get the earliest note in a lane which hasn't been judged yet.
+	 * Amortized O(1), as each lane keeps a cursor.
+	 *
+	 * @param lane Lane index.
+	 * @return Note index, or NONE if all notes in the lane are judged.
+	 */
+	size_t getNextUnjudged(int lane);
+	void setJudged(size_t index);
+	bool isJudged(size_t index) const;
+	void resetJudgement();
+
+private:
+	std::vector<float> times;
+	std::vector<float> lengths;
+	std::vector<float> endTimes;
+	// Running maximum of endTimes, so it's sorted too.
+	std::vector<float> maxEndTimes;
+	std::vector<uint8_t> lanes;
+	std::vector<uint8_t> effects;
+	std::vector<uint8_t> visibilities;
+	std::vector<uint8_t> swings;
+	std::vector<uint32_t> groups;
+	std::vector<uint8_t> images;
+	std::vector<uint32_t> colors;
+
+	void buildIndices();
+
+	std::vector<uint32_t> laneNotes[LANE_COUNT];
+	size_t laneCursors[LANE_COUNT];
+	std::vector<uint8_t> judged;
+};
+
+} // beatmap
+} // livesim
+
+#endif
@@ -63,8 +63,13 @@ GameConfiguration conf = {
 	// love.filesystem
 	// love.thread
 	std::vector<std::string>({
-		"audio", "data", "event", "font", "graphics", "image",
-		"joystick", "keyboard", "math", "mouse", "physics", "sound",
-		"timer", "touch", "video", "window"
+		"data", "event", "font", "graphics", "image",
+		"keyboard", "mouse", "timer", "touch", "window"
+	}),
+	// lazymodules
+	// Modules which are loaded on first use. They're not needed by the
+	// title screen, so don't let them delay the first frame.
+	std::vector<std::string>({
+		"audio", "joystick", "math", "physics", "sound", "video"
 	})
 };
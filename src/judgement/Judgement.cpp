@@ -0,0 +1,451 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// love
+#include "common/math.h"
+
+// Judgement
+#include "Judgement.h"
+
+namespace livesim
+{
+namespace judgement
+{
+
+using beatmap::Note;
+using beatmap::NoteTable;
+using base::InputEvent;
+using love::keyboard::Keyboard;
+
+namespace
+{
+
+// Defaults, in the 960x640 screen used by Sukufesu
+const float DEFAULT_WINDOWS[JUDGEMENT_MAX_ENUM] = {0.016f, 0.040f, 0.064f, 0.112f, 0.128f};
+const float DEFAULT_CENTER_X = 480.0f;
+const float DEFAULT_CENTER_Y = 160.0f;
+const float DEFAULT_RADIUS = 400.0f;
+const float DEFAULT_TAP_RADIUS = 96.0f;
+const int DEFAULT_NOTE_SCORE = 500;
+
+// In percent, to keep score integer.
+const int JUDGEMENT_MULTIPLIER[JUDGEMENT_MAX_ENUM] = {125, 110, 100, 50, 0};
+
+int getComboMultiplier(int combo)
+{
+	if (combo < 50)
+		return 100;
+	else if (combo < 100)
+		return 110;
+	else if (combo < 200)
+		return 115;
+	else if (combo < 400)
+		return 120;
+	else if (combo < 600)
+		return 125;
+	else if (combo < 800)
+		return 130;
+	else
+		return 135;
+}
+
+// Mouse is tracked as a pointer with this id.
+const int64_t MOUSE_POINTER_ID = -1;
+
+} // anonymous
+
+JudgementEngine::JudgementEngine(NoteTable *notes)
+	: notes(notes)
+	, origin(0.0)
+	, centerX(DEFAULT_CENTER_X)
+	, centerY(DEFAULT_CENTER_Y)
+	, radius(DEFAULT_RADIUS)
+	, tapRadius(DEFAULT_TAP_RADIUS)
+	, noteScore(DEFAULT_NOTE_SCORE)
+{
+	setWindows(DEFAULT_WINDOWS);
+
+	memset(keyLanes, -1, sizeof(keyLanes));
+	// Sukufesu simulator default, leftmost to rightmost
+	const Keyboard::Key keys[NoteTable::LANE_COUNT] = {
+		Keyboard::KEY_A, Keyboard::KEY_S, Keyboard::KEY_D, Keyboard::KEY_F,
+		Keyboard::KEY_SPACE,
+		Keyboard::KEY_J, Keyboard::KEY_K, Keyboard::KEY_L, Keyboard::KEY_SEMICOLON
+	};
+	for (int i = 0; i < NoteTable::LANE_COUNT; i++)
+		keyLanes[keys[i]] = (int8_t) (NoteTable::LANE_COUNT - 1 - i);
+
+	reset();
+}
+
+void JudgementEngine::reset()
+{
+	for (int i = 0; i < MAX_POINTERS; i++)
+		pointers[i].active = false;
+
+	for (int i = 0; i < NoteTable::LANE_COUNT; i++)
+	{
+		holding[i] = NoteTable::NONE;
+		holders[i] = HOLDER_NONE;
+	}
+
+	score = 0;
+	combo = maxCombo = 0;
+	for (int i = 0; i < JUDGEMENT_MAX_ENUM; i++)
+		counts[i] = 0;
+
+	notes->resetJudgement();
+	input.clear();
+	results.clear();
+}
+
+void JudgementEngine::setTimeOrigin(double origin)
+{
+	this->origin = origin;
+}
+
+double JudgementEngine::getTimeOrigin() const
+{
+	return origin;
+}
+
+void JudgementEngine::setWindows(const float windows[JUDGEMENT_MAX_ENUM])
+{
+	for (int i = 0; i < JUDGEMENT_MAX_ENUM; i++)
+		this->windows[i] = windows[i];
+}
+
+void JudgementEngine::setLaneLayout(float x, float y, float radius, float tapRadius)
+{
+	centerX = x;
+	centerY = y;
+	this->radius = radius;
+	this->tapRadius = tapRadius;
+}
+
+void JudgementEngine::setKeyLane(Keyboard::Key key, int lane)
+{
+	if (key >= 0 && key < Keyboard::KEY_MAX_ENUM)
+		keyLanes[key] = (int8_t) (lane >= 0 && lane < NoteTable::LANE_COUNT ? lane : -1);
+}
+
+int JudgementEngine::getLaneAt(double x, double y) const
+{
+	double dx = x - centerX;
+	double dy = y - centerY;
+	double distance = sqrt(dx * dx + dy * dy);
+
+	if (fabs(distance - radius) > tapRadius)
+		return -1;
+
+	// Lane 0 is at angle 0 (right), lane 8 at pi (left), below the center.
+	double angle = atan2(dy, dx);
+	if (angle < -LOVE_M_PI_2)
+		angle = LOVE_M_PI;
+	else if (angle < 0.0)
+		angle = 0.0;
+
+	return (int) floor(angle / (LOVE_M_PI / (NoteTable::LANE_COUNT - 1)) + 0.5);
+}
+
+bool JudgementEngine::pushInput(const InputEvent &e)
+{
+	return input.push(e);
+}
+
+void JudgementEngine::update(double time)
+{
+	InputEvent e;
+
+	// Misses up to each event are judged before the event, so the result
+	// doesn't depend on how often update() is called. Replays rely on this.
+	while (input.pop(e))
+	{
+		double eventTime = e.time - origin;
+		for (int i = 0; i < NoteTable::LANE_COUNT; i++)
+			judgeMisses(i, eventTime);
+
+		handleInput(e);
+	}
+
+	double songTime = time - origin;
+	for (int i = 0; i < NoteTable::LANE_COUNT; i++)
+		judgeMisses(i, songTime);
+}
+
+bool JudgementEngine::pollResult(JudgementEvent &e)
+{
+	return results.pop(e);
+}
+
+void JudgementEngine::setNoteScore(int score)
+{
+	noteScore = score;
+}
+
+int64_t JudgementEngine::getScore() const
+{
+	return score;
+}
+
+int JudgementEngine::getCombo() const
+{
+	return combo;
+}
+
+int JudgementEngine::getMaxCombo() const
+{
+	return maxCombo;
+}
+
+int JudgementEngine::getCount(Judgement judgement) const
+{
+	if (judgement < 0 || judgement >= JUDGEMENT_MAX_ENUM)
+		return 0;
+
+	return counts[judgement];
+}
+
+void JudgementEngine::handleInput(const InputEvent &e)
+{
+	double time = e.time - origin;
+
+	switch (e.type)
+	{
+	case InputEvent::KEY_PRESSED:
+		if (!e.repeat && e.key >= 0 && e.key < Keyboard::KEY_MAX_ENUM && keyLanes[e.key] >= 0)
+			press(keyLanes[e.key], time, HOLDER_KEYBOARD, false);
+		break;
+	case InputEvent::KEY_RELEASED:
+		if (e.key >= 0 && e.key < Keyboard::KEY_MAX_ENUM && keyLanes[e.key] >= 0)
+			release(keyLanes[e.key], time, HOLDER_KEYBOARD);
+		break;
+	case InputEvent::MOUSE_PRESSED:
+	case InputEvent::TOUCH_PRESSED:
+	{
+		// Touch also generates mouse events, judge it once.
+		if (e.type == InputEvent::MOUSE_PRESSED && (e.istouch || e.button != 1))
+			break;
+
+		Pointer *p = getPointer(e.type == InputEvent::TOUCH_PRESSED ? e.id : MOUSE_POINTER_ID, true);
+		if (p == nullptr)
+			break;
+
+		p->lane = getLaneAt(e.x, e.y);
+		p->group = 0;
+		if (p->lane >= 0)
+			press(p->lane, time, int(p - pointers), false);
+		break;
+	}
+	case InputEvent::MOUSE_MOVED:
+	case InputEvent::TOUCH_MOVED:
+	{
+		if (e.type == InputEvent::MOUSE_MOVED && e.istouch)
+			break;
+
+		Pointer *p = getPointer(e.type == InputEvent::TOUCH_MOVED ? e.id : MOUSE_POINTER_ID, false);
+		if (p == nullptr)
+			break;
+
+		int lane = getLaneAt(e.x, e.y);
+		if (lane == p->lane)
+			break;
+
+		// Sliding off a held long note releases it.
+		if (p->lane >= 0)
+			release(p->lane, time, int(p - pointers));
+
+		p->lane = lane;
+		if (lane >= 0)
+			press(lane, time, int(p - pointers), true);
+		break;
+	}
+	case InputEvent::MOUSE_RELEASED:
+	case InputEvent::TOUCH_RELEASED:
+	{
+		if (e.type == InputEvent::MOUSE_RELEASED && (e.istouch || e.button != 1))
+			break;
+
+		Pointer *p = getPointer(e.type == InputEvent::TOUCH_RELEASED ? e.id : MOUSE_POINTER_ID, false);
+		if (p == nullptr)
+			break;
+
+		if (p->lane >= 0)
+			release(p->lane, time, int(p - pointers));
+
+		p->active = false;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+JudgementEngine::Pointer *JudgementEngine::getPointer(int64_t id, bool create)
+{
+	Pointer *freeSlot = nullptr;
+
+	for (int i = 0; i < MAX_POINTERS; i++)
+	{
+		if (pointers[i].active && pointers[i].id == id)
+			return &pointers[i];
+		else if (!pointers[i].active && freeSlot == nullptr)
+			freeSlot = &pointers[i];
+	}
+
+	if (!create || freeSlot == nullptr)
+		return nullptr;
+
+	freeSlot->active = true;
+	freeSlot->id = id;
+	freeSlot->lane = -1;
+	freeSlot->group = 0;
+	return freeSlot;
+}
+
+void JudgementEngine::press(int lane, double time, int holder, bool slide)
+{
+	judgeMisses(lane, time);
+
+	// Lane is busy with a long note.
+	if (holding[lane] != NoteTable::NONE)
+		return;
+
+	size_t index = notes->getNextUnjudged(lane);
+	if (index == NoteTable::NONE)
+		return;
+
+	float offset = (float) (time - notes->getTimes()[index]);
+	if (offset < -windows[JUDGEMENT_MISS])
+		return;
+
+	bool swing = notes->getSwings()[index] != 0;
+	uint32_t group = notes->getGroups()[index];
+	Pointer *p = holder >= 0 ? &pointers[holder] : nullptr;
+
+	// Sliding only hits swing notes, of the same group as the last one.
+	if (slide && (!swing || (p && p->group != 0 && p->group != group)))
+		return;
+
+	Judgement judgement = classify(offset);
+	bool isLong = notes->getEffects()[index] == Note::EFFECT_LONG;
+
+	notes->setJudged(index);
+
+	if (p && swing)
+		p->group = group;
+
+	if (isLong && judgement != JUDGEMENT_MISS)
+	{
+		holding[lane] = index;
+		holders[lane] = holder;
+		emit(index, lane, judgement, offset, time, true);
+	}
+	else
+		emit(index, lane, judgement, offset, time, false);
+}
+
+void JudgementEngine::release(int lane, double time, int holder)
+{
+	size_t index = holding[lane];
+	if (index == NoteTable::NONE || holders[lane] != holder)
+		return;
+
+	float offset = (float) (time - notes->getEndTimes()[index]);
+	// Releasing too early breaks the long note.
+	Judgement judgement = offset < -windows[JUDGEMENT_MISS] ? JUDGEMENT_MISS : classify(offset);
+
+	holding[lane] = NoteTable::NONE;
+	holders[lane] = HOLDER_NONE;
+	emit(index, lane, judgement, offset, time, false);
+}
+
+void JudgementEngine::judgeMisses(int lane, double time)
+{
+	size_t held = holding[lane];
+	if (held != NoteTable::NONE && time - notes->getEndTimes()[held] > windows[JUDGEMENT_BAD])
+	{
+		holding[lane] = NoteTable::NONE;
+		holders[lane] = HOLDER_NONE;
+		emit(held, lane, JUDGEMENT_MISS, (float) (time - notes->getEndTimes()[held]), time, false);
+	}
+
+	for (;;)
+	{
+		size_t index = notes->getNextUnjudged(lane);
+		if (index == NoteTable::NONE)
+			break;
+
+		float offset = (float) (time - notes->getTimes()[index]);
+		if (offset <= windows[JUDGEMENT_BAD])
+			break;
+
+		notes->setJudged(index);
+		emit(index, lane, JUDGEMENT_MISS, offset, time, false);
+	}
+}
+
+Judgement JudgementEngine::classify(float offset) const
+{
+	float abs = fabsf(offset);
+
+	for (int i = 0; i < JUDGEMENT_MISS; i++)
+	{
+		if (abs <= windows[i])
+			return (Judgement) i;
+	}
+
+	return JUDGEMENT_MISS;
+}
+
+void JudgementEngine::emit(size_t note, int lane, Judgement judgement, float offset, double time, bool holdStart)
+{
+	// Long note start isn't counted, its release is.
+	if (!holdStart)
+	{
+		counts[judgement]++;
+
+		if (judgement == JUDGEMENT_MISS || judgement == JUDGEMENT_BAD)
+			combo = 0;
+		else
+			maxCombo = std::max(maxCombo, ++combo);
+
+		score += (int64_t) noteScore * JUDGEMENT_MULTIPLIER[judgement] * getComboMultiplier(combo) / 10000;
+	}
+
+	JudgementEvent e;
+	e.note = note;
+	e.lane = lane;
+	e.judgement = judgement;
+	e.offset = offset;
+	e.time = time;
+	e.holdStart = holdStart;
+
+	// Results nobody polls are dropped, combo and counts are still right.
+	results.push(e);
+}
+
+} // judgement
+} // livesim
@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_JUDGEMENT_JUDGEMENT_H
+#define LIVESIM_JUDGEMENT_JUDGEMENT_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+// love
+#include "modules/keyboard/Keyboard.h"
+
+// Input
+#include "../Input.h"
+
+// Beatmap
+#include "../beatmap/NoteTable.h"
+
+// SPSCRing
+#include "SPSCRing.h"
+
+namespace livesim
+{
+namespace judgement
+{
+
+enum Judgement
+{
+	JUDGEMENT_PERFECT = 0,
+	JUDGEMENT_GREAT,
+	JUDGEMENT_GOOD,
+	JUDGEMENT_BAD,
+	JUDGEMENT_MISS,
+	JUDGEMENT_MAX_ENUM
+};
+
+struct JudgementEvent
+{
+	// Index in the NoteTable
+	size_t note;
+	int lane;
+	Judgement judgement;
+	// Input time minus note time, in seconds. Positive means late.
+	float offset;
+	// Song position of the judgement
+	double time;
+	// True for the start of a long note, which is judged again on release.
+	bool holdStart;
+};
+
+/*
+ * Judges input against notes. Input is queued by the producer thread with
+ * pushInput() and judged by the consumer thread in update(), in O(1) per
+ * event using the per-lane cursors of the NoteTable. Nothing is allocated
+ * after construction.
+ *
+ * Lanes follow NoteTable, lane 0 is the rightmost (position 1).
+ */
+class JudgementEngine
+{
+public:
+	static const size_t INPUT_CAPACITY = 256;
+	static const size_t RESULT_CAPACITY = 1024;
+	static const int MAX_POINTERS = 16;
+
+	/**
+	 * Create judgement engine.
+	 *
+	 * @param notes Notes to judge. Must outlive the engine, and its
+	 *        judgement state is modified.
+	 */
+	JudgementEngine(beatmap::NoteTable *notes);
+	/* Reset judgement, combo, and the NoteTable judgement state. */
+	void reset();
+
+	/**
+	 * Set love.timer time where song position is 0.
+	 *
+	 * @param origin Time in love.timer clock.
+	 */
+	void setTimeOrigin(double origin);
+	double getTimeOrigin() const;
+	/**
+	 * Set judgement windows.
+	 *
+	 * @param windows Maximum absolute offset, in seconds, for perfect,
+	 *        great, good, bad and miss. Earlier input is ignored.
+	 */
+	void setWindows(const float windows[JUDGEMENT_MAX_ENUM]);
+	/**
+	 * Set where lanes are, in input coordinates. Lanes are laid on a half
+	 * circle below the center, from lane 0 on the right to lane 8 on the left.
+	 *
+	 * @param x Center X.
+	 * @param y Center Y.
+	 * @param radius Distance between the center and the lanes.
+	 * @param tapRadius How far from the half circle a tap still counts.
+	 */
+	void setLaneLayout(float x, float y, float radius, float tapRadius);
+	/**
+	 * Bind key to lane.
+	 *
+	 * @param key Keyboard key.
+	 * @param lane Lane index, or -1 to unbind.
+	 */
+	void setKeyLane(love::keyboard::Keyboard::Key key, int lane);
+	/**
+	 * Get lane at position.
+	 *
+	 * @return Lane index, or -1 if it's not on any lane.
+	 */
+	int getLaneAt(double x, double y) const;
+
+	/**
+	 * Queue input event. Producer thread only.
+	 *
+	 * @return false if the queue is full and the event is dropped.
+	 */
+	bool pushInput(const base::InputEvent &e);
+	/**
+	 * Judge queued input, then judge notes which are too late as miss.
+	 * Consumer thread only.
+	 *
+	 * @param time Current time, in love.timer clock.
+	 */
+	void update(double time);
+	/**
+	 * Take oldest judgement result. Consumer thread only.
+	 *
+	 * @return false if there's none.
+	 */
+	bool pollResult(JudgementEvent &e);
+
+	/**
+	 * Set score of a perfect note without combo bonus. Each judged note
+	 * scores this times the judgement multiplier (1.25, 1.1, 1, 0.5, 0)
+	 * times the combo multiplier (1 below 50 combo up to 1.35 at 800).
+	 *
+	 * @param score Base note score.
+	 */
+	void setNoteScore(int score);
+	int64_t getScore() const;
+	int getCombo() const;
+	int getMaxCombo() const;
+	int getCount(Judgement judgement) const;
+
+private:
+	struct Pointer
+	{
+		bool active;
+		int64_t id;
+		int lane;
+		// Swing group of the last swing note hit by this pointer
+		uint32_t group;
+	};
+
+	// Holder of a long note pressed by keyboard
+	static const int HOLDER_KEYBOARD = -2;
+	static const int HOLDER_NONE = -1;
+
+	void handleInput(const base::InputEvent &e);
+	Pointer *getPointer(int64_t id, bool create);
+	void press(int lane, double time, int holder, bool slide);
+	void release(int lane, double time, int holder);
+	void judgeMisses(int lane, double time);
+	Judgement classify(float offset) const;
+	void emit(size_t note, int lane, Judgement judgement, float offset, double time, bool holdStart);
+
+	beatmap::NoteTable *notes;
+	double origin;
+	float windows[JUDGEMENT_MAX_ENUM];
+	float centerX, centerY, radius, tapRadius;
+	int8_t keyLanes[love::keyboard::Keyboard::KEY_MAX_ENUM];
+
+	Pointer pointers[MAX_POINTERS];
+	// Long note being held in each lane and who holds it
+	size_t holding[beatmap::NoteTable::LANE_COUNT];
+	int holders[beatmap::NoteTable::LANE_COUNT];
+
+	int noteScore;
+	int64_t score;
+	int combo;
+	int maxCombo;
+	int counts[JUDGEMENT_MAX_ENUM];
+
+	SPSCRing<base::InputEvent, INPUT_CAPACITY> input;
+	SPSCRing<JudgementEvent, RESULT_CAPACITY> results;
+};
+
+} // judgement
+} // livesim
+
+#endif
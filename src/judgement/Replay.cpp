@@ -0,0 +1,413 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// love
+#include "common/Exception.h"
+#include "modules/data/ByteData.h"
+#include "modules/keyboard/Keyboard.h"
+
+// Beatmap
+#include "../beatmap/BeatmapCache.h"
+
+// Pack
+#include "../pack/MappedFile.h"
+
+// Replay
+#include "Replay.h"
+
+using livesim::base::InputEvent;
+using love::keyboard::Keyboard;
+
+namespace livesim
+{
+namespace judgement
+{
+
+namespace
+{
+
+const double TIME_SCALE = 1000000.0;
+const double POSITION_SCALE = 16.0;
+const uint8_t TYPE_MASK = 0x0F;
+const uint8_t FLAG_BIT = 0x10;
+// Enough for 64-bit value
+const int MAX_VARINT_LENGTH = 10;
+
+uint64_t zigzag(int64_t v)
+{
+	return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v)
+{
+	return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+void writeVarint(std::vector<uint8_t> &out, uint64_t v)
+{
+	uint8_t buffer[MAX_VARINT_LENGTH];
+	int length = 0;
+
+	// Least significant group first, then written reversed.
+	do
+	{
+		buffer[length++] = uint8_t(v & 0x7F);
+		v >>= 7;
+	} while (v > 0);
+
+	for (int i = length - 1; i > 0; i--)
+		out.push_back(buffer[i] | 0x80);
+
+	out.push_back(buffer[0]);
+}
+
+int64_t quantize(double v, double scale)
+{
+	return (int64_t) floor(v * scale + 0.5);
+}
+
+bool isMouse(InputEvent::Type type)
+{
+	return type >= InputEvent::MOUSE_PRESSED && type <= InputEvent::MOUSE_MOVED;
+}
+
+bool isTouch(InputEvent::Type type)
+{
+	return type >= InputEvent::TOUCH_PRESSED && type <= InputEvent::TOUCH_MOVED;
+}
+
+} // anonymous namespace
+
+ReplayRecorder::ReplayRecorder(uint64_t beatmapHash, uint32_t difficulty, size_t reserve)
+	: origin(0.0)
+	, lastTime(0)
+	, lastX(0)
+	, lastY(0)
+{
+	memset(&header, 0, sizeof(ReplayHeader));
+	memcpy(header.magic, REPLAY_MAGIC, 4);
+	header.version = REPLAY_VERSION;
+	header.beatmapHash = beatmapHash;
+	header.difficulty = difficulty;
+
+	stream.reserve(reserve);
+}
+
+void ReplayRecorder::setTimeOrigin(double origin)
+{
+	this->origin = origin;
+}
+
+void ReplayRecorder::record(InputEvent &e)
+{
+	int64_t time = quantize(e.time - origin, TIME_SCALE);
+	uint8_t type = uint8_t(e.type);
+
+	writeVarint(stream, zigzag(time - lastTime));
+	lastTime = time;
+	e.time = origin + time / TIME_SCALE;
+
+	if (e.type == InputEvent::KEY_PRESSED && e.repeat)
+		type |= FLAG_BIT;
+	else if (isMouse(e.type) && e.istouch)
+		type |= FLAG_BIT;
+
+	stream.push_back(type);
+
+	if (isMouse(e.type) || isTouch(e.type))
+	{
+		if (isTouch(e.type))
+			writeVarint(stream, zigzag(e.id));
+
+		int64_t x = quantize(e.x, POSITION_SCALE);
+		int64_t y = quantize(e.y, POSITION_SCALE);
+		writeVarint(stream, zigzag(x - lastX));
+		writeVarint(stream, zigzag(y - lastY));
+		lastX = x;
+		lastY = y;
+		e.x = x / POSITION_SCALE;
+		e.y = y / POSITION_SCALE;
+
+		if (e.type == InputEvent::MOUSE_PRESSED || e.type == InputEvent::MOUSE_RELEASED)
+			writeVarint(stream, uint64_t(e.button));
+	}
+	else
+		writeVarint(stream, uint64_t(e.key));
+
+	header.eventCount++;
+}
+
+void ReplayRecorder::setResult(const JudgementEngine &engine)
+{
+	header.score = engine.getScore();
+	header.maxCombo = (uint32_t) engine.getMaxCombo();
+
+	for (int i = 0; i < JUDGEMENT_MAX_ENUM; i++)
+		header.counts[i] = (uint32_t) engine.getCount((Judgement) i);
+}
+
+love::Data *ReplayRecorder::encode() const
+{
+	ReplayHeader out = header;
+	out.streamSize = (uint32_t) stream.size();
+
+	love::data::ByteData *data = new love::data::ByteData(sizeof(ReplayHeader) + stream.size());
+	uint8_t *ptr = (uint8_t *) data->getData();
+
+	memcpy(ptr, &out, sizeof(ReplayHeader));
+	if (!stream.empty())
+		memcpy(ptr + sizeof(ReplayHeader), &stream[0], stream.size());
+
+	return data;
+}
+
+ReplayReader::ReplayReader(love::Data *data)
+	: data(data)
+	, stream(nullptr)
+{
+	if (data->getSize() < sizeof(ReplayHeader))
+		throw love::Exception("Replay is too small");
+
+	memcpy(&header, data->getData(), sizeof(ReplayHeader));
+
+	if (memcmp(header.magic, REPLAY_MAGIC, 4) != 0)
+		throw love::Exception("Not a replay file");
+	if (header.version != REPLAY_VERSION)
+		throw love::Exception("Unsupported replay version %u", header.version);
+	if (header.streamSize > data->getSize() - sizeof(ReplayHeader))
+		throw love::Exception("Replay is truncated");
+
+	stream = (const uint8_t *) data->getData() + sizeof(ReplayHeader);
+	rewind();
+}
+
+const ReplayHeader &ReplayReader::getHeader() const
+{
+	return header;
+}
+
+void ReplayReader::rewind()
+{
+	position = 0;
+	eventIndex = 0;
+	lastTime = lastX = lastY = 0;
+}
+
+uint64_t ReplayReader::readVarint()
+{
+	uint64_t v = 0;
+
+	for (int i = 0; i < MAX_VARINT_LENGTH; i++)
+	{
+		if (position >= header.streamSize)
+			throw love::Exception("Replay event stream is truncated");
+
+		uint8_t b = stream[position++];
+		v = (v << 7) | (b & 0x7F);
+
+		if ((b & 0x80) == 0)
+			return v;
+	}
+
+	throw love::Exception("Invalid varint in replay event stream");
+}
+
+bool ReplayReader::next(InputEvent &e)
+{
+	if (eventIndex >= header.eventCount)
+		return false;
+
+	lastTime += unzigzag(readVarint());
+
+	if (position >= header.streamSize)
+		throw love::Exception("Replay event stream is truncated");
+
+	uint8_t type = stream[position++];
+	bool flag = (type & FLAG_BIT) != 0;
+
+	e.type = InputEvent::Type(type & TYPE_MASK);
+	e.time = lastTime / TIME_SCALE;
+	e.key = Keyboard::KEY_UNKNOWN;
+	e.scancode = Keyboard::SCANCODE_UNKNOWN;
+	e.repeat = false;
+	e.x = e.y = e.dx = e.dy = 0.0;
+	e.button = 0;
+	e.istouch = false;
+	e.id = 0;
+	e.pressure = 0.0;
+
+	if (e.type > InputEvent::TOUCH_MOVED)
+		throw love::Exception("Invalid replay event type %d", int(e.type));
+
+	if (isMouse(e.type) || isTouch(e.type))
+	{
+		if (isTouch(e.type))
+		{
+			e.id = unzigzag(readVarint());
+			e.pressure = 1.0;
+		}
+		else
+			e.istouch = flag;
+
+		int64_t x = lastX + unzigzag(readVarint());
+		int64_t y = lastY + unzigzag(readVarint());
+		e.x = x / POSITION_SCALE;
+		e.y = y / POSITION_SCALE;
+		lastX = x;
+		lastY = y;
+
+		if (e.type == InputEvent::MOUSE_PRESSED || e.type == InputEvent::MOUSE_RELEASED)
+			e.button = (int32_t) readVarint();
+	}
+	else
+	{
+		e.key = Keyboard::Key(readVarint());
+		e.repeat = flag;
+	}
+
+	eventIndex++;
+	return true;
+}
+
+bool verifyReplay(love::Data *beatmap, love::Data *replay, ReplayResult &result)
+{
+	ReplayReader reader(replay);
+	const ReplayHeader &header = reader.getHeader();
+
+	result.beatmapMatch = beatmap::hashSource(beatmap) == header.beatmapHash;
+	result.resultMatch = false;
+	result.scoreRank = result.comboRank = -1;
+	result.duration = 0.0;
+
+	if (!result.beatmapMatch)
+		return false;
+
+	beatmap::BeatmapInfo info;
+	beatmap::Difficulty diff;
+	beatmap::NoteTable notes;
+	beatmap::loadDifficulty(beatmap, header.difficulty, info, diff, notes);
+
+	JudgementEngine engine(&notes);
+	JudgementEvent judged;
+	InputEvent e;
+
+	// Results aren't needed, only the counters, but keep the queue drained.
+	while (reader.next(e))
+	{
+		engine.pushInput(e);
+		engine.update(e.time);
+		while (engine.pollResult(judged)) {}
+
+		result.duration = e.time;
+	}
+
+	// Let every remaining note be judged as miss.
+	const float *endTimes = notes.getEndTimes();
+	double end = result.duration;
+	for (size_t i = 0; i < notes.size(); i++)
+		end = std::max(end, (double) endTimes[i]);
+
+	engine.update(end + 1.0);
+	while (engine.pollResult(judged)) {}
+
+	result.score = engine.getScore();
+	result.maxCombo = engine.getMaxCombo();
+	result.resultMatch = result.score == header.score && (uint32_t) result.maxCombo == header.maxCombo;
+
+	for (int i = 0; i < JUDGEMENT_MAX_ENUM; i++)
+	{
+		result.counts[i] = engine.getCount((Judgement) i);
+		result.resultMatch = result.resultMatch && (uint32_t) result.counts[i] == header.counts[i];
+	}
+
+	for (int i = 0; i < beatmap::RANK_MAX_ENUM; i++)
+	{
+		if (result.score >= (int64_t) diff.score[i])
+			result.scoreRank = i;
+		if ((uint32_t) result.maxCombo >= diff.combo[i])
+			result.comboRank = i;
+	}
+
+	return result.resultMatch;
+}
+
+bool verifyReplayFiles(const std::string &beatmap, const std::vector<std::string> &replays)
+{
+	static const char RANK_NAMES[] = "CBAS";
+	bool ok = true;
+
+	try
+	{
+		love::StrongRef<pack::MappedFile> beatmapFile(new pack::MappedFile(beatmap), love::Acquire::NORETAIN);
+		love::StrongRef<love::Data> beatmapData(new pack::MappedData(beatmapFile, 0, beatmapFile->getSize()), love::Acquire::NORETAIN);
+
+		for (const std::string &path: replays)
+		{
+			ReplayResult result;
+
+			try
+			{
+				love::StrongRef<pack::MappedFile> replayFile(new pack::MappedFile(path), love::Acquire::NORETAIN);
+				love::StrongRef<love::Data> replayData(new pack::MappedData(replayFile, 0, replayFile->getSize()), love::Acquire::NORETAIN);
+
+				if (verifyReplay(beatmapData, replayData, result))
+					printf("%s: OK score %lld (%c) combo %d (%c) perfect %d great %d good %d bad %d miss %d\n",
+						path.c_str(), (long long) result.score,
+						result.scoreRank >= 0 ? RANK_NAMES[result.scoreRank] : '-',
+						result.maxCombo,
+						result.comboRank >= 0 ? RANK_NAMES[result.comboRank] : '-',
+						result.counts[JUDGEMENT_PERFECT], result.counts[JUDGEMENT_GREAT],
+						result.counts[JUDGEMENT_GOOD], result.counts[JUDGEMENT_BAD],
+						result.counts[JUDGEMENT_MISS]);
+				else
+				{
+					ok = false;
+
+					if (!result.beatmapMatch)
+						printf("%s: FAIL replay is for different beatmap\n", path.c_str());
+					else
+						printf("%s: FAIL replayed score %lld combo %d doesn't match the claimed result\n",
+							path.c_str(), (long long) result.score, result.maxCombo);
+				}
+			}
+			catch (love::Exception &e)
+			{
+				ok = false;
+				printf("%s: FAIL %s\n", path.c_str(), e.what());
+			}
+		}
+	}
+	catch (love::Exception &e)
+	{
+		fprintf(stderr, "Cannot load %s: %s\n", beatmap.c_str(), e.what());
+		return false;
+	}
+
+	return ok;
+}
+
+} // judgement
+} // livesim
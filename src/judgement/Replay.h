@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_JUDGEMENT_REPLAY_H
+#define LIVESIM_JUDGEMENT_REPLAY_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// love
+#include "common/Data.h"
+#include "common/Object.h"
+
+// Input
+#include "../Input.h"
+
+// Judgement
+#include "Judgement.h"
+
+namespace livesim
+{
+namespace judgement
+{
+
+/*
+ * Replay file layout. All integers in the header are little-endian.
+ *
+ * ReplayHeader
+ * Event stream, streamSize bytes. Each event is:
+ * varint - Time since previous event (or since song position 0 for the
+ *          first one) in microseconds, zigzag-encoded
+ * byte   - InputEvent::Type in the low 4 bits. Bit 4 is repeat for key
+ *          press, istouch for mouse events.
+ * Key events:
+ * varint - Key
+ * Mouse events:
+ * varint - X, then Y, difference from the previous mouse or touch event,
+ *          in 1/16 units, zigzag-encoded
+ * varint - Button (pressed and released only)
+ * Touch events:
+ * varint - Touch ID, zigzag-encoded
+ * varint - X, then Y, same as mouse events
+ *
+ * varint uses the MIDI-like encoding of the FiLive! beatmap specification:
+ * 7 bits per byte, most significant group first, highest bit set on every
+ * byte except the last.
+ */
+
+const char REPLAY_MAGIC[4] = {'L', 'S', 'R', 'P'};
+const uint32_t REPLAY_VERSION = 1;
+
+struct ReplayHeader
+{
+	char magic[4];
+	uint32_t version;
+	// beatmap::hashSource() of the beatmap file
+	uint64_t beatmapHash;
+	uint32_t difficulty;
+	uint32_t eventCount;
+	uint32_t streamSize;
+	// Result claimed by the player
+	uint32_t maxCombo;
+	int64_t score;
+	uint32_t counts[JUDGEMENT_MAX_ENUM];
+	uint32_t reserved;
+};
+
+static_assert(sizeof(ReplayHeader) == 64, "ReplayHeader must be 64 bytes");
+
+/*
+ * Records input of a play. Events are stored at microsecond and 1/16 unit
+ * precision.
+ */
+class ReplayRecorder
+{
+public:
+	/**
+	 * @param beatmapHash beatmap::hashSource() of the beatmap file.
+	 * @param difficulty Difficulty index.
+	 * @param reserve Stream bytes to allocate in advance, so recording
+	 *        doesn't allocate during play.
+	 */
+	ReplayRecorder(uint64_t beatmapHash, uint32_t difficulty, size_t reserve = 65536);
+	/**
+	 * Set love.timer time where song position is 0. Must be same as the
+	 * JudgementEngine time origin.
+	 */
+	void setTimeOrigin(double origin);
+	/**
+	 * Record input event. The event is rounded in place to what's stored,
+	 * pass the rounded event to JudgementEngine so playing the replay
+	 * gives the same result.
+	 *
+	 * @param e Input event, not older than previously recorded one.
+	 */
+	void record(base::InputEvent &e);
+	/* Store result of the play, to be checked against the replay. */
+	void setResult(const JudgementEngine &engine);
+	/**
+	 * Encode the replay.
+	 *
+	 * @return New Data containing the replay file.
+	 */
+	love::Data *encode() const;
+
+private:
+	ReplayHeader header;
+	std::vector<uint8_t> stream;
+	double origin;
+	int64_t lastTime;
+	int64_t lastX, lastY;
+};
+
+/*
+ * Reads replay events sequentially, straight from the replay data.
+ */
+class ReplayReader
+{
+public:
+	/**
+	 * @param data Replay file contents. Retained.
+	 * @throws love::Exception if the header is invalid.
+	 */
+	ReplayReader(love::Data *data);
+	const ReplayHeader &getHeader() const;
+	/**
+	 * Read next event. Event time is song position, in seconds.
+	 *
+	 * @param e Where the event is stored.
+	 * @return false if there are no more events.
+	 * @throws love::Exception if the stream is truncated or invalid.
+	 */
+	bool next(base::InputEvent &e);
+	/* Go back to the first event. */
+	void rewind();
+
+private:
+	uint64_t readVarint();
+
+	love::StrongRef<love::Data> data;
+	ReplayHeader header;
+	const uint8_t *stream;
+	size_t position;
+	uint32_t eventIndex;
+	int64_t lastTime;
+	int64_t lastX, lastY;
+};
+
+struct ReplayResult
+{
+	// Replay is for the beatmap file
+	bool beatmapMatch;
+	// Replayed result is same as the claimed result
+	bool resultMatch;
+	int64_t score;
+	int maxCombo;
+	int counts[JUDGEMENT_MAX_ENUM];
+	// Highest rank reached, or -1 if below rank C.
+	int scoreRank;
+	int comboRank;
+	// Song position where the replay ends, in seconds.
+	double duration;
+};
+
+/**
+ * Judge replay again against the beatmap, without graphics nor audio, and
+ * compare it with the claimed result. Ranks are from the score and combo
+ * thresholds of the difficulty.
+ *
+ * @param beatmap FiLive! beatmap file contents.
+ * @param replay Replay file contents.
+ * @param result Where the result is stored.
+ * @return true if the replay is for the beatmap and the result matches.
+ * @throws love::Exception if the beatmap or the replay is invalid.
+ */
+bool verifyReplay(love::Data *beatmap, love::Data *replay, ReplayResult &result);
+/**
+ * Verify replays of a beatmap and print the results to stdout. Used by
+ * "livesim4 --verify-replay <beatmap> <replays...>".
+ *
+ * @param beatmap Native path to the beatmap file.
+ * @param replays Native paths to the replay files.
+ * @return true if every replay is verified.
+ */
+bool verifyReplayFiles(const std::string &beatmap, const std::vector<std::string> &replays);
+
+} // judgement
+} // livesim
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_JUDGEMENT_SPSCRING_H
+#define LIVESIM_JUDGEMENT_SPSCRING_H
+
+// std
+#include <atomic>
+#include <cstddef>
+
+namespace livesim
+{
+namespace judgement
+{
+
+/*
+ * Lock-free fixed-size ring for exactly one producer thread and one
+ * consumer thread. Holds up to N - 1 items and never allocates.
+ */
+template<typename T, size_t N>
+class SPSCRing
+{
+public:
+	SPSCRing()
+		: head(0)
+		, tail(0)
+	{}
+
+	/**
+	 * Add item. Producer only.
+	 *
+	 * @return false if the ring is full.
+	 */
+	bool push(const T &item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = (t + 1) % N;
+
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+
+		items[t] = item;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Take oldest item. Consumer only.
+	 *
+	 * @return false if the ring is empty.
+	 */
+	bool pop(T &item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+
+		item = items[h];
+		head.store((h + 1) % N, std::memory_order_release);
+		return true;
+	}
+
+	/* Discard all items. Consumer only. */
+	void clear()
+	{
+		head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+private:
+	T items[N];
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+};
+
+} // judgement
+} // livesim
+
+#endif
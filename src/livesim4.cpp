@@ -20,7 +20,10 @@
 
 // std
 #include <cstdlib>
+#include <cstring>
 #include <exception>
+#include <string>
+#include <vector>
 
 extern "C" {
 // Lua
@@ -51,6 +54,18 @@ extern "C" int luaopen_lvep(lua_State *L);
 // Asset manager
 #include "AssetManager.h"
 
+// Boot
+#include "Boot.h"
+
+// Main loop
+#include "MainLoop.h"
+
+// Pack
+#include "pack/Pack.h"
+
+// Replay
+#include "judgement/Replay.h"
+
 // scene
 #include "Scene.h"
 
@@ -67,14 +82,18 @@ LOVE_EXPORT DWORD AmdPowerXpressRequestHighPerformance = 1;
 class SimpleSceneTest: public livesim::base::Scene
 {
 public:
-	SimpleSceneTest(void *args): Scene(args)
+	SimpleSceneTest(void *args): Scene(args), livesim2_image(nullptr)
 	{
-		livesim2_image = lovewrap::graphics::newImage("livesim2_icon.png");
+		// No love.graphics when running headless
+		if (lovewrap::graphics::getInstance())
+			livesim2_image = lovewrap::graphics::newImage("livesim2_icon.png");
 	}
 	~SimpleSceneTest()
 	{
 		fprintf(stdout, "love.quit");
-		livesim2_image->release();
+
+		if (livesim2_image)
+			livesim2_image->release();
 	}
 	void draw()
 	{
@@ -83,137 +102,11 @@ public:
 		//livesim2_image->draw(0, 0, 0, 0.25, 0.25, 0, 0, 0, 0);
 		lovewrap::graphics::draw(livesim2_image, 0, 0, 0.25, 0.25);
 	}
-	void update(double deltaT)
-	{
-		fprintf(stdout, "deltaT: %g\n", deltaT);
-	}
 private:
 	love::graphics::Drawable *livesim2_image;
 };
 
-// Simple inlined function :P
-inline void setCFunction(lua_State *L, const char *name, lua_CFunction func)
-{
-	auto f = [](lua_State *L)->int
-	{
-		lua_CFunction func = (lua_CFunction) (lua_topointer(L, lua_upvalueindex(1)));
-
-		try
-		{
-			return func(L);
-		}
-		catch(love::Exception &e)
-		{
-			return luaL_error(L, "LOVE Error: %s", e.what());
-		}
-		catch(std::exception &e)
-		{
-			return luaL_error(L, "Exception: %s", e.what());
-		}
-		catch(...)
-		{
-			return luaL_error(L, "Unknown exception!");
-		}
-	};
-
-	lua_pushstring(L, name);
-	lua_pushlightuserdata(L, func);
-	lua_pushcclosure(L, f, 1);
-	lua_rawset(L, -3);
-}
-
-// This function hijack most LOVE callbacks and love.update and love.draw
-int hijackHandlers(lua_State *L)
-{
-	using namespace livesim::base;
-
-	// Load our scene
-	loadScene(new SimpleSceneTest(nullptr));
-	swapScene(); // forced
-
-	// Get love table
-	lua_getglobal(L, "love");
-
-	// love.update
-	setCFunction(L, "update", [](lua_State *L)->int
-	{
-		getCurrentScene()->update(luaL_checknumber(L, 1));
-		return 0;
-	});
-
-	// love.draw
-	setCFunction(L, "draw", [](lua_State *L)->int
-	{
-		getCurrentScene()->draw();
-		swapScene();
-		return 0;
-	});
-
-	// love.quit
-	setCFunction(L, "quit", [](lua_State *L)->int
-	{
-		return 0;
-	});
-
-	// Get love.handlers now.
-	lua_getfield(L, -1, "handlers");
-
-	// love.focus
-	setCFunction(L, "focus", [](lua_State *L)->int
-	{
-		getCurrentScene()->focus(lua_toboolean(L, 1));
-		return 0;
-	});
-
-	// love.visible
-	setCFunction(L, "visible", [](lua_State *L)->int
-	{
-		getCurrentScene()->visible(lua_toboolean(L, 1));
-		return 0;
-	});
-
-	// love.resize
-	setCFunction(L, "resize", [](lua_State *L)->int
-	{
-		getCurrentScene()->resize(luaL_checkinteger(L, 1), luaL_checkinteger(L, 2));
-		return 0;
-	});
-
-	// love.keypressed
-	setCFunction(L, "keypressed", [](lua_State *L)->int
-	{
-		love::keyboard::Keyboard::Key key;
-		love::keyboard::Keyboard::Scancode sc;
-		if (!love::keyboard::Keyboard::getConstant(luaL_checkstring(L, 1), key))
-			return luaL_error(L, "invalid key");
-		if (!love::keyboard::Keyboard::getConstant(luaL_checkstring(L, 2), sc))
-			return luaL_error(L, "invalid scancode");
-
-		getCurrentScene()->keyPressed(key, sc, lua_toboolean(L, 3));
-		return 0;
-	});
-
-	// love.keyreleased
-	setCFunction(L, "keyreleased", [](lua_State *L)->int
-	{
-		love::keyboard::Keyboard::Key key;
-		love::keyboard::Keyboard::Scancode sc;
-		if (!love::keyboard::Keyboard::getConstant(luaL_checkstring(L, 1), key))
-			return luaL_error(L, "invalid key");
-		if (!love::keyboard::Keyboard::getConstant(luaL_checkstring(L, 2), sc))
-			return luaL_error(L, "invalid scancode");
-
-		getCurrentScene()->keyReleased(key, sc);
-		return 0;
-	});
-
-	// Remove love.handlers and love table
-	lua_pop(L, 2);
-
-	// Just send dummy table, lol
-	lua_newtable(L);
-	return 1;
-}
+static livesim::base::SceneRegistrar<SimpleSceneTest> simpleSceneTestRegistrar("SimpleSceneTest");
 
 int runLivesim4(int argc, char *argv[])
 {
@@ -232,8 +125,6 @@ int runLivesim4(int argc, char *argv[])
 	lua_setfield(L, -2, "love");
 	lua_pushcfunction(L, &luaopen_lvep);
 	lua_setfield(L, -2, "lvep");
-	lua_pushcfunction(L, &hijackHandlers);
-	lua_setfield(L, -2, "livesim4");
 
 	// Add command line arguments to global arg (like stand-alone Lua).
 	{
@@ -255,47 +146,48 @@ int runLivesim4(int argc, char *argv[])
 	lua_pushstring(L, "love");
 	lua_call(L, 1, 0);
 	// Boot
-
+	bootLivesim4(L);
+#ifdef _DEBUG
+	printBootReport();
+#endif
 
 	// Initialize scene
 	livesim::base::initializeScene();
+	// Initialize asynchronous asset loader
+	livesim::asset::initialize();
 
-	// get debug.traceback
-	lua_getglobal(L, "debug");
-	lua_getfield(L, -1, "traceback");
-	
-	// require "love.boot" (preloaded when love was required)
-	lua_getglobal(L, "require");
-	lua_pushstring(L, "love.boot");
-	lua_call(L, 1, 1);
+	// Load our scene
+	livesim::base::loadScene(new SimpleSceneTest(nullptr));
+	livesim::base::swapScene(); // forced
 
-	// Call the returned boot function.
-	int status = lua_pcall(L, 0, 1, lua_gettop(L) - 1);
-	int retval = 0;
+	// Run the game loop. Events are dispatched natively,
+	// love.run and love.handlers are not used.
+	int retval = livesim::base::runMainLoop();
 
-	// If status is nonzero, that means there's error.
-	if (status)
-	{
-		retval = 1;
-		fprintf(stderr, "Lua Error: %s", lua_tostring(L, -1));
-	}
-	else
-		// If the boot function return number, then
-		// it should be the status code
-		if (lua_isnumber(L, -1))
-			retval = (int)lua_tonumber(L, -1);
-		
 	livesim::base::freeScene();
+	livesim::asset::deinitialize();
+	freeBoot();
 	lua_close(L);
 
 	// Back control to main
 	return retval;
 }
 
+#ifndef LIVESIM_BENCHMARK
 int main(int argc, char *argv[])
 {
 	// Init PhysFS
 	PHYSFS_init(argv[0]);
+
+	// Asset pack creation: livesim4 --pack <directory> <output>
+	// If output exists (e.g. copy of this executable), the pack is appended.
+	if (argc == 4 && strcmp(argv[1], "--pack") == 0)
+		return livesim::pack::packDirectory(argv[2], argv[3]) ? 0 : 1;
+
+	// Replay verification: livesim4 --verify-replay <beatmap> <replays...>
+	// Replays are judged again headless, without graphics nor audio.
+	if (argc >= 4 && strcmp(argv[1], "--verify-replay") == 0)
+		return livesim::judgement::verifyReplayFiles(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
 	
 	// Open libav
 	av_register_all();
@@ -321,3 +213,4 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 }
+#endif // LIVESIM_BENCHMARK
@@ -61,6 +61,7 @@ namespace love
 
 love::Type Module::type("Module", &Object::type);
 Module *Module::instances[] = {};
+Module::LoadHook Module::loadHook = nullptr;
 
 Module::Module()
 {
@@ -124,6 +125,11 @@ void Module::registerInstance(Module *instance)
 	instances[moduletype] = instance;
 }
 
+void Module::setLoadHook(LoadHook hook)
+{
+	loadHook = hook;
+}
+
 Module *Module::getInstance(const std::string &name)
 {
 	ModuleRegistry &registry = registryInstance();
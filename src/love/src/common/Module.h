@@ -99,12 +99,28 @@ public:
 	template <typename T>
 	static T *getInstance(ModuleType type)
 	{
+		if (instances[type] == nullptr && loadHook != nullptr)
+			loadHook(type);
+
 		return (T *) instances[type];
 	}
 
+	/**
+	 * Function called by getInstance(ModuleType) when the module is not
+	 * registered, so it can be loaded on demand.
+	 **/
+	typedef void (*LoadHook)(ModuleType type);
+
+	/**
+	 * Set the on-demand module loader. Pass null to disable it.
+	 * @param hook The loader function.
+	 **/
+	static void setLoadHook(LoadHook hook);
+
 private:
 
 	static Module *instances[M_MAX_ENUM];
+	static LoadHook loadHook;
 
 }; // Module
 
@@ -63,6 +63,8 @@ public:
 	Variant &operator = (const Variant &v);
 
 	Type getType() const { return type; }
+	// Gets the number value, or 0 if this Variant is not a number.
+	double getNumber() const { return type == NUMBER ? data.number : 0.0; }
 
 	static Variant fromLua(lua_State *L, int n, std::set<const void*> *tableSet = nullptr);
 	void toLua(lua_State *L) const;
@@ -49,6 +49,9 @@ public:
 	int toLua(lua_State *L);
 	static Message *fromLua(lua_State *L, int n);
 
+	const std::string &getName() const { return name; }
+	const std::vector<Variant> &getArgs() const { return args; }
+
 private:
 
 	std::string name;
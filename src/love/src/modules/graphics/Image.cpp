@@ -165,10 +165,15 @@ void Image::replacePixels(love::image::ImageDataBase *d, int slice, int mipmap,
 }
 
 void Image::replacePixels(const void *data, size_t size, int slice, int mipmap, const Rect &rect, bool reloadmipmaps)
+{
+	replacePixels(data, size, slice, mipmap, rect, 0, reloadmipmaps);
+}
+
+void Image::replacePixels(const void *data, size_t size, int slice, int mipmap, const Rect &rect, int stride, bool reloadmipmaps)
 {
 	Graphics::flushStreamDrawsGlobal();
 
-	uploadByteData(format, data, size, mipmap, slice, rect);
+	uploadByteData(format, data, size, mipmap, slice, rect, stride);
 
 	if (reloadmipmaps && mipmap == 0 && getMipmapCount() > 1)
 		generateMipmaps();
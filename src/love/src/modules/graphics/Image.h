@@ -95,6 +95,8 @@ public:
 
 	void replacePixels(love::image::ImageDataBase *d, int slice, int mipmap, int x, int y, bool reloadmipmaps);
 	void replacePixels(const void *data, size_t size, int slice, int mipmap, const Rect &rect, bool reloadmipmaps);
+	// Rows of data are stride pixels apart rather than rect.w, or packed if stride is 0.
+	void replacePixels(const void *data, size_t size, int slice, int mipmap, const Rect &rect, int stride, bool reloadmipmaps);
 
 	bool isFormatLinear() const;
 	bool isCompressed() const;
@@ -113,7 +115,7 @@ protected:
 	Image(TextureType textype, PixelFormat format, int width, int height, int slices, const Settings &settings);
 
 	void uploadImageData(love::image::ImageDataBase *d, int level, int slice, int x, int y);
-	virtual void uploadByteData(PixelFormat pixelformat, const void *data, size_t size, int level, int slice, const Rect &r) = 0;
+	virtual void uploadByteData(PixelFormat pixelformat, const void *data, size_t size, int level, int slice, const Rect &r, int stride = 0) = 0;
 
 	virtual void generateMipmaps() = 0;
 
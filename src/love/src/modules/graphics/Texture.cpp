@@ -78,6 +78,11 @@ void Texture::setGraphicsMemorySize(int64 bytes)
 	totalGraphicsMemory += bytes;
 }
 
+int64 Texture::getGraphicsMemorySize() const
+{
+	return graphicsMemorySize;
+}
+
 TextureType Texture::getTextureType() const
 {
 	return texType;
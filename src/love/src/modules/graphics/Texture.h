@@ -133,6 +133,9 @@ public:
 
 	float getDPIScale() const;
 
+	// Gets the size of the texture in GPU memory, in bytes.
+	int64 getGraphicsMemorySize() const;
+
 	virtual void setFilter(const Filter &f);
 	virtual const Filter &getFilter() const;
 
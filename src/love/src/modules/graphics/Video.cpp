@@ -24,6 +24,9 @@
 #include "Shader.h"
 #include "Graphics.h"
 
+// C++
+#include <algorithm>
+
 namespace love
 {
 namespace graphics
@@ -72,6 +75,8 @@ Video::Video(Graphics *gfx, love::video::VideoStream *stream, float dpiscale)
 	int widths[3]  = {frame->yw, frame->cw, frame->cw};
 	int heights[3] = {frame->yh, frame->ch, frame->ch};
 
+	int strides[3] = {frame->ystride, frame->cstride, frame->cstride};
+
 	const unsigned char *data[3] = {frame->yplane, frame->cbplane, frame->crplane};
 
 	Texture::Wrap wrap; // Clamp wrap mode.
@@ -84,11 +89,12 @@ Video::Video(Graphics *gfx, love::video::VideoStream *stream, float dpiscale)
 		img->setFilter(filter);
 		img->setWrap(wrap);
 
+		// Strides are in bytes, and R8 is a byte per pixel.
 		size_t bpp = getPixelFormatSize(PIXELFORMAT_R8);
-		size_t size = bpp * widths[i] * heights[i];
+		size_t size = bpp * std::max(strides[i], widths[i]) * heights[i];
 
 		Rect rect = {0, 0, widths[i], heights[i]};
-		img->replacePixels(data[i], size, 0, 0, rect, false);
+		img->replacePixels(data[i], size, 0, 0, rect, strides[i], false);
 
 		images[i].set(img, Acquire::NORETAIN);
 	}
@@ -155,15 +161,17 @@ void Video::update()
 		int widths[3]  = {frame->yw, frame->cw, frame->cw};
 		int heights[3] = {frame->yh, frame->ch, frame->ch};
 
+		int strides[3] = {frame->ystride, frame->cstride, frame->cstride};
+
 		const unsigned char *data[3] = {frame->yplane, frame->cbplane, frame->crplane};
 
 		for (int i = 0; i < 3; i++)
 		{
 			size_t bpp = getPixelFormatSize(PIXELFORMAT_R8);
-			size_t size = bpp * widths[i] * heights[i];
+			size_t size = bpp * std::max(strides[i], widths[i]) * heights[i];
 
 			Rect rect = {0, 0, widths[i], heights[i]};
-			images[i]->replacePixels(data[i], size, 0, 0, rect, false);
+			images[i]->replacePixels(data[i], size, 0, 0, rect, strides[i], false);
 		}
 	}
 }
@@ -147,7 +147,7 @@ void Image::loadData()
 		generateMipmaps();
 }
 
-void Image::uploadByteData(PixelFormat pixelformat, const void *data, size_t size, int level, int slice, const Rect &r)
+void Image::uploadByteData(PixelFormat pixelformat, const void *data, size_t size, int level, int slice, const Rect &r, int stride)
 {
 	OpenGL::TempDebugGroup debuggroup("Image data upload");
 
@@ -169,12 +169,32 @@ void Image::uploadByteData(PixelFormat pixelformat, const void *data, size_t siz
 		else if (texType == TEXTURE_2D_ARRAY || texType == TEXTURE_VOLUME)
 			glCompressedTexSubImage3D(gltarget, level, 0, 0, slice, r.w, r.h, 1, fmt.internalformat, size, data);
 	}
+	else if (stride > 0 && stride != r.w && !(GLAD_ES_VERSION_3_0 || GLAD_EXT_unpack_subimage || !GLAD_ES_VERSION_2_0))
+	{
+		// No GL_UNPACK_ROW_LENGTH, upload row by row.
+		const uint8 *row = (const uint8 *) data;
+		size_t rowsize = getPixelFormatSize(pixelformat) * stride;
+
+		for (int y = 0; y < r.h; y++, row += rowsize)
+		{
+			if (texType == TEXTURE_2D || texType == TEXTURE_CUBE)
+				glTexSubImage2D(gltarget, level, r.x, r.y + y, r.w, 1, fmt.externalformat, fmt.type, row);
+			else if (texType == TEXTURE_2D_ARRAY || texType == TEXTURE_VOLUME)
+				glTexSubImage3D(gltarget, level, r.x, r.y + y, slice, r.w, 1, 1, fmt.externalformat, fmt.type, row);
+		}
+	}
 	else
 	{
+		if (stride > 0 && stride != r.w)
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+
 		if (texType == TEXTURE_2D || texType == TEXTURE_CUBE)
 			glTexSubImage2D(gltarget, level, r.x, r.y, r.w, r.h, fmt.externalformat, fmt.type, data);
 		else if (texType == TEXTURE_2D_ARRAY || texType == TEXTURE_VOLUME)
 			glTexSubImage3D(gltarget, level, r.x, r.y, slice, r.w, r.h, 1, fmt.externalformat, fmt.type, data);
+
+		if (stride > 0 && stride != r.w)
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 	}
 }
 
@@ -68,6 +68,8 @@ VideoStream::Frame::Frame()
 	: yplane(nullptr)
 	, cbplane(nullptr)
 	, crplane(nullptr)
+	, ystride(0)
+	, cstride(0)
 {
 }
 
@@ -69,6 +69,10 @@ public:
 		int cw, ch;
 		unsigned char *cbplane;
 		unsigned char *crplane;
+
+		// Distance between rows of the planes in bytes, or 0 if the rows
+		// are packed (same as the width).
+		int ystride, cstride;
 	};
 
 	class FrameSync : public Object
@@ -42,5 +42,25 @@ bool areSymlinksEnabled()
 	return getInstance()->areSymlinksEnabled();
 }
 
+bool setSource(const std::string &source)
+{
+	return getInstance()->setSource(source.c_str());
+}
+
+std::string getExecutablePath()
+{
+	return getInstance()->getExecutablePath();
+}
+
+void setFused(bool fused)
+{
+	getInstance()->setFused(fused);
+}
+
+bool setIdentity(const std::string &identity, bool appendToPath)
+{
+	return getInstance()->setIdentity(identity.c_str(), appendToPath);
+}
+
 } // filesystem
 } // love
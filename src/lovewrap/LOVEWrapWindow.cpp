@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// love
+#include "common/Module.h"
+
+// lovewrap
+#include "LOVEWrap.h"
+
+namespace lovewrap
+{
+namespace window
+{
+
+static Window *getInstance()
+{
+	return love::Module::getInstance<Window>(love::Module::M_WINDOW);
+}
+
+bool setMode(int width, int height, WindowSettings *settings)
+{
+	return getInstance()->setWindow(width, height, settings);
+}
+
+void setTitle(const std::string &title)
+{
+	getInstance()->setWindowTitle(title);
+}
+
+bool setIcon(love::image::ImageData *imgd)
+{
+	return getInstance()->setIcon(imgd);
+}
+
+} // window
+} // lovewrap
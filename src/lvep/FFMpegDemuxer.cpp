@@ -0,0 +1,503 @@
+#include "FFMpegDemuxer.h"
+
+// STL
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// LOVE
+#include <common/Module.h>
+#include <filesystem/Filesystem.h>
+#include <libraries/xxHash/xxhash.h>
+
+namespace
+{
+
+// Persisted index layout: IndexHeader, then count IndexEntry
+const char INDEX_MAGIC[4] = {'L', 'V', 'I', 'X'};
+const uint32_t INDEX_VERSION = 2;
+
+struct IndexHeader
+{
+	char magic[4];
+	uint32_t version;
+	int64_t fileSize;
+	int64_t modTime;
+	int32_t stream;
+	uint32_t count;
+};
+
+} // anonymous namespace
+
+std::string FFMpegDemuxer::indexDirectory;
+
+FFMpegDemuxer::DemuxThread::DemuxThread(FFMpegDemuxer *demuxer)
+	: demuxer(demuxer)
+{
+	threadName = "LVEPDemuxer";
+}
+
+void FFMpegDemuxer::DemuxThread::threadFunction()
+{
+	demuxer->demux();
+}
+
+FFMpegDemuxer::FFMpegDemuxer(love::filesystem::File *file)
+	: ioContext(file)
+	, formatContext(nullptr)
+	, file(file)
+	, demuxThread(nullptr)
+	, indexStream(-1)
+	, indexComplete(false)
+	, containerIndex(false)
+	, indexing(true)
+	, indexedUntil(AV_NOPTS_VALUE)
+	, fileSize(0)
+	, modTime(-1)
+	, serial(0)
+	, seekTarget(0)
+	, starving(0)
+	, eof(false)
+	, stopping(false)
+{
+	initialize(file->getFilename(), file->getSize());
+}
+
+FFMpegDemuxer::FFMpegDemuxer(love::filesystem::FileData *fileData)
+	: ioContext(fileData)
+	, formatContext(nullptr)
+	, fileData(fileData)
+	, demuxThread(nullptr)
+	, indexStream(-1)
+	, indexComplete(false)
+	, containerIndex(false)
+	, indexing(true)
+	, indexedUntil(AV_NOPTS_VALUE)
+	, fileSize(0)
+	, modTime(-1)
+	, serial(0)
+	, seekTarget(0)
+	, starving(0)
+	, eof(false)
+	, stopping(false)
+{
+	initialize(fileData->getFilename(), (int64_t) fileData->getSize());
+}
+
+void FFMpegDemuxer::initialize(const std::string &filename, int64_t fileSize)
+{
+	formatContext = avformat_alloc_context();
+	formatContext->pb = ioContext;
+
+	// avformat_open_input frees the context on failure
+	if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0)
+		throw love::Exception("Could not open input stream");
+
+	if (avformat_find_stream_info(formatContext, nullptr) < 0)
+	{
+		avformat_close_input(&formatContext);
+		throw love::Exception("Could not find stream information");
+	}
+
+	queues.resize(formatContext->nb_streams);
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+	{
+		queues[i].enabled = false;
+		formatContext->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	// The demux thread starts at the first readPacket
+	loadIndex(filename, fileSize);
+}
+
+FFMpegDemuxer::~FFMpegDemuxer()
+{
+	{
+		love::thread::Lock l(mutex);
+		stopping = true;
+		cond->broadcast();
+	}
+
+	if (demuxThread)
+	{
+		demuxThread->wait();
+		demuxThread->release();
+	}
+
+	flushQueues();
+	avformat_close_input(&formatContext);
+}
+
+int FFMpegDemuxer::findStream(AVMediaType type) const
+{
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+		if (formatContext->streams[i]->codec->codec_type == type)
+			return i;
+
+	return -1;
+}
+
+AVStream *FFMpegDemuxer::getStream(int index) const
+{
+	return formatContext->streams[index];
+}
+
+void FFMpegDemuxer::enableStream(int index)
+{
+	// Stream discard flags are read by av_read_frame
+	love::thread::Lock io(ioMutex);
+	love::thread::Lock l(mutex);
+
+	if (queues[index].enabled)
+		throw love::Exception("Stream is already decoded");
+
+	queues[index].enabled = true;
+	formatContext->streams[index]->discard = AVDISCARD_DEFAULT;
+	cond->broadcast();
+}
+
+void FFMpegDemuxer::disableStream(int index)
+{
+	love::thread::Lock io(ioMutex);
+	love::thread::Lock l(mutex);
+	PacketQueue &queue = queues[index];
+
+	for (size_t i = 0; i < queue.packets.size(); i++)
+		av_packet_unref(&queue.packets[i]);
+
+	queue.packets.clear();
+	queue.enabled = false;
+	formatContext->streams[index]->discard = AVDISCARD_ALL;
+	cond->broadcast();
+
+	// Its keyframes aren't read anymore
+	if (index == indexStream)
+		indexing = false;
+}
+
+bool FFMpegDemuxer::readPacket(int index, AVPacket *packet, int &serial, double &seekTarget)
+{
+	love::thread::Lock l(mutex);
+	PacketQueue &queue = queues[index];
+
+	// Streams enabled by now are queued from the start
+	if (!demuxThread)
+	{
+		demuxThread = new DemuxThread(this);
+		demuxThread->start();
+	}
+
+	while (queue.enabled && queue.packets.empty() && !eof && !stopping)
+	{
+		starving++;
+		cond->broadcast();
+		cond->wait(mutex);
+		starving--;
+	}
+
+	serial = this->serial;
+	seekTarget = this->seekTarget;
+	if (!queue.enabled || queue.packets.empty())
+		return false;
+
+	*packet = queue.packets.front();
+	queue.packets.pop_front();
+	cond->broadcast();
+	return true;
+}
+
+bool FFMpegDemuxer::seek(double target)
+{
+	love::thread::Lock io(ioMutex);
+	bool success;
+
+	const IndexEntry *keyframe = findKeyframe(target);
+	if (keyframe)
+	{
+		// Straight to the keyframe. By byte offset if the format allows, but
+		// not with the container's index, which its own seek code uses.
+		if (!containerIndex && keyframe->pos >= 0 && !(formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK))
+			success = av_seek_frame(formatContext, indexStream, keyframe->pos, AVSEEK_FLAG_BYTE) >= 0;
+		else
+			success = av_seek_frame(formatContext, indexStream, keyframe->pts, AVSEEK_FLAG_BACKWARD) >= 0;
+	}
+	else
+	{
+		// Default stream and AV_TIME_BASE, so it lands on a video keyframe
+		int64_t ts = (int64_t) (target * AV_TIME_BASE);
+		success = av_seek_frame(formatContext, -1, ts, AVSEEK_FLAG_BACKWARD) >= 0;
+
+		// Packets from here on don't continue the index, but what's
+		// indexed so far stays valid.
+		indexing = false;
+	}
+
+	love::thread::Lock l(mutex);
+	flushQueues();
+	serial++;
+	seekTarget = target;
+	eof = false;
+	cond->broadcast();
+	return success;
+}
+
+bool FFMpegDemuxer::ownsSeeking(int index) const
+{
+	love::thread::Lock l(mutex);
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		if ((int) i != index && queues[i].enabled && formatContext->streams[i]->codec->codec_type == AVMEDIA_TYPE_AUDIO)
+			return false;
+	}
+
+	return true;
+}
+
+int FFMpegDemuxer::getSerial() const
+{
+	love::thread::Lock l(mutex);
+	return serial;
+}
+
+void FFMpegDemuxer::setIndexDirectory(const std::string &directory)
+{
+	indexDirectory = directory;
+}
+
+size_t FFMpegDemuxer::getIndexSize() const
+{
+	love::thread::Lock io(ioMutex);
+	return index.size();
+}
+
+void FFMpegDemuxer::loadIndex(const std::string &filename, int64_t fileSize)
+{
+	this->fileSize = fileSize;
+	indexStream = findStream(AVMEDIA_TYPE_VIDEO);
+	if (indexStream == -1)
+		return;
+
+	// Containers like MP4 and Matroska with cues come with a complete index
+	AVStream *stream = formatContext->streams[indexStream];
+	for (int i = 0; i < stream->nb_index_entries; i++)
+	{
+		const AVIndexEntry &entry = stream->index_entries[i];
+		if (entry.flags & AVINDEX_KEYFRAME)
+		{
+			IndexEntry keyframe = {entry.timestamp, entry.pos};
+			index.push_back(keyframe);
+		}
+	}
+
+	if (!index.empty())
+	{
+		indexComplete = containerIndex = true;
+		return;
+	}
+
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+	if (indexDirectory.empty() || fs == nullptr || *fs->getSaveDirectory() == 0)
+		return;
+
+	// Without modification time, a replaced file of the same size would
+	// get the old index, so it's not persisted then.
+	love::filesystem::Filesystem::Info info = {};
+	if (!fs->getInfo(filename.c_str(), info) || info.modtime < 0)
+		return;
+
+	modTime = info.modtime;
+
+	char name[96];
+	sprintf(name, "/%016llx-%lld-%lld.lvix", (unsigned long long) XXH64(filename.c_str(), filename.length(), 0), (long long) fileSize, (long long) modTime);
+	indexName = indexDirectory + name;
+
+	if (!fs->getInfo(indexName.c_str(), info))
+		return;
+
+	try
+	{
+		love::StrongRef<love::filesystem::FileData> data(fs->read(indexName.c_str()), love::Acquire::NORETAIN);
+		const uint8_t *ptr = (const uint8_t *) data->getData();
+		IndexHeader header;
+
+		if (data->getSize() < sizeof(IndexHeader))
+			return;
+
+		memcpy(&header, ptr, sizeof(IndexHeader));
+		if (memcmp(header.magic, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION ||
+			header.fileSize != fileSize || header.modTime != modTime || header.stream != indexStream || header.count == 0 ||
+			data->getSize() != sizeof(IndexHeader) + header.count * sizeof(IndexEntry))
+			return;
+
+		index.resize(header.count);
+		memcpy(&index[0], ptr + sizeof(IndexHeader), header.count * sizeof(IndexEntry));
+		indexComplete = true;
+	}
+	catch (love::Exception &)
+	{
+		// Built again then
+	}
+}
+
+void FFMpegDemuxer::saveIndex()
+{
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+	if (indexName.empty() || index.empty() || fs == nullptr)
+		return;
+
+	IndexHeader header;
+	memcpy(header.magic, INDEX_MAGIC, 4);
+	header.version = INDEX_VERSION;
+	header.fileSize = fileSize;
+	header.modTime = modTime;
+	header.stream = indexStream;
+	header.count = (uint32_t) index.size();
+
+	std::vector<uint8_t> buffer(sizeof(IndexHeader) + index.size() * sizeof(IndexEntry));
+	memcpy(&buffer[0], &header, sizeof(IndexHeader));
+	memcpy(&buffer[sizeof(IndexHeader)], &index[0], index.size() * sizeof(IndexEntry));
+
+	try
+	{
+		fs->createDirectory(indexDirectory.c_str());
+		fs->write(indexName.c_str(), &buffer[0], (love::int64) buffer.size());
+	}
+	catch (love::Exception &)
+	{
+		// Built again next time
+	}
+}
+
+void FFMpegDemuxer::addToIndex(const AVPacket &packet)
+{
+	if (indexComplete || !indexing || packet.stream_index != indexStream || packet.pts == AV_NOPTS_VALUE)
+		return;
+
+	// Packets before indexedUntil are read again after seeking within the index.
+	if ((packet.flags & AV_PKT_FLAG_KEY) && (index.empty() || packet.pts > index.back().pts))
+	{
+		IndexEntry keyframe = {packet.pts, packet.pos};
+		index.push_back(keyframe);
+	}
+
+	if (indexedUntil == AV_NOPTS_VALUE || packet.pts > indexedUntil)
+		indexedUntil = packet.pts;
+}
+
+const FFMpegDemuxer::IndexEntry *FFMpegDemuxer::findKeyframe(double target) const
+{
+	if (index.empty())
+		return nullptr;
+
+	AVRational &base = formatContext->streams[indexStream]->time_base;
+	int64_t ts = (int64_t) (target*base.den/double(base.num));
+
+	// Beyond what has been read, the keyframe before the target isn't known.
+	if (!indexComplete && ts > indexedUntil)
+		return nullptr;
+
+	struct Compare
+	{
+		bool operator()(int64_t ts, const IndexEntry &entry) const
+		{
+			return ts < entry.pts;
+		}
+	};
+
+	std::vector<IndexEntry>::const_iterator it = std::upper_bound(index.begin(), index.end(), ts, Compare());
+	return it == index.begin() ? &index[0] : &*(it - 1);
+}
+
+void FFMpegDemuxer::flushQueues()
+{
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		for (size_t j = 0; j < queues[i].packets.size(); j++)
+			av_packet_unref(&queues[i].packets[j]);
+
+		queues[i].packets.clear();
+	}
+}
+
+bool FFMpegDemuxer::isFull(size_t limit) const
+{
+	for (size_t i = 0; i < queues.size(); i++)
+		if (queues[i].enabled && queues[i].packets.size() >= limit)
+			return true;
+
+	return false;
+}
+
+void FFMpegDemuxer::dropPackets(PacketQueue &queue)
+{
+	// Its consumer doesn't keep up while another one starves. Drop up to
+	// a keyframe, so it can continue decoding from there.
+	do
+	{
+		av_packet_unref(&queue.packets.front());
+		queue.packets.pop_front();
+	}
+	while (!queue.packets.empty() && (queue.packets.size() >= HARD_MAX_QUEUED_PACKETS || !(queue.packets.front().flags & AV_PKT_FLAG_KEY)));
+}
+
+void FFMpegDemuxer::demux()
+{
+	AVPacket packet;
+	av_init_packet(&packet);
+	packet.data = nullptr;
+	packet.size = 0;
+
+	while (true)
+	{
+		{
+			love::thread::Lock l(mutex);
+
+			// Nothing to read for, or read enough unless someone starves
+			while (!stopping && (eof || (isFull(MAX_QUEUED_PACKETS) && starving == 0)))
+				cond->wait(mutex);
+
+			if (stopping)
+				return;
+		}
+
+		love::thread::Lock io(ioMutex);
+
+		int result = av_read_frame(formatContext, &packet);
+
+		if (result < 0)
+		{
+			// Read the whole file from the start, the index is complete.
+			if (indexing && !indexComplete && indexedUntil != AV_NOPTS_VALUE)
+			{
+				indexComplete = true;
+				saveIndex();
+			}
+
+			love::thread::Lock l(mutex);
+			eof = true;
+			cond->broadcast();
+			continue;
+		}
+
+		addToIndex(packet);
+		love::thread::Lock l(mutex);
+
+		PacketQueue &queue = queues[packet.stream_index];
+		if (queue.enabled)
+		{
+			// Make sure the packet doesn't point to demuxer memory
+			AVPacket queued;
+			if (av_packet_ref(&queued, &packet) == 0)
+			{
+				if (queue.packets.size() >= HARD_MAX_QUEUED_PACKETS)
+					dropPackets(queue);
+
+				queue.packets.push_back(queued);
+				cond->broadcast();
+			}
+		}
+
+		av_packet_unref(&packet);
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "LFSIOContext.h"
+
+// STL
+#include <deque>
+#include <string>
+#include <vector>
+
+// LOVE
+#include <common/Exception.h>
+#include <common/Object.h>
+#include <filesystem/File.h>
+#include <filesystem/FileData.h>
+#include <thread/threads.h>
+
+// FFMPEG
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+// Reads packets of a file on its own thread and routes them to a queue per
+// enabled stream, so the audio and the video of one file are read and
+// parsed once. Shared by the FFMpegStreams decoding it.
+//
+// Seeks go straight to the keyframe before the target using a keyframe
+// index of the video stream. It's taken from the container if it has one
+// (e.g. MP4), otherwise it's built from the packets read from the start
+// of the file, and persisted once the whole file has been read.
+//
+// With audio and video enabled, the audio consumer owns seeking. love seeks
+// a Video with a Source through the Source and the video follows its clock,
+// so the video's seeks are ignored and it continues from the audio's seeks.
+class FFMpegDemuxer : public love::Object
+{
+public:
+	// Packets queued per stream before the demuxer waits for its consumer.
+	// Exceeded when another stream is starving, e.g. when its consumer
+	// doesn't run. Beyond HARD_MAX_QUEUED_PACKETS the oldest packets are
+	// dropped instead, so the starving stream is never blocked by it.
+	static const size_t MAX_QUEUED_PACKETS = 256;
+	static const size_t HARD_MAX_QUEUED_PACKETS = 2048;
+
+	FFMpegDemuxer(love::filesystem::File *file);
+	FFMpegDemuxer(love::filesystem::FileData *fileData);
+	virtual ~FFMpegDemuxer();
+
+	// Best stream of type, or -1 if there's none
+	int findStream(AVMediaType type) const;
+	AVStream *getStream(int index) const;
+	// Start queueing packets of the stream. Call once per consumer.
+	void enableStream(int index);
+	// Stop queueing packets of the stream and drop the queued ones. Wakes
+	// a readPacket of the stream waiting for the demuxer, which returns
+	// false from then on. Called by the consumer when it's done.
+	void disableStream(int index);
+
+	// Take next packet of the stream, waiting for the demuxer if needed.
+	// The demuxer starts reading at the first call, so every consumer
+	// created before gets the file from the start.
+	// serial changes when the file is seeked, the decoder must be flushed
+	// and skip to seekTarget (FFMpegStream::skipUntil) when it does.
+	// Returns false at end of file or when the stream is disabled.
+	bool readPacket(int index, AVPacket *packet, int &serial, double &seekTarget);
+	// Seek the whole file, so every enabled stream continues from there.
+	// Lands on a keyframe of the default (video) stream at or before target.
+	bool seek(double target);
+	// Whether seeks of the stream's consumer should move the file, see above
+	bool ownsSeeking(int index) const;
+	int getSerial() const;
+
+	// Directory in the save directory where built keyframe indices are
+	// persisted, or empty (the default) to not persist them.
+	static void setIndexDirectory(const std::string &directory);
+	// Number of indexed keyframes, for debugging
+	size_t getIndexSize() const;
+
+private:
+	class DemuxThread : public love::thread::Threadable
+	{
+	public:
+		DemuxThread(FFMpegDemuxer *demuxer);
+		void threadFunction();
+
+	private:
+		FFMpegDemuxer *demuxer;
+	};
+
+	struct PacketQueue
+	{
+		bool enabled;
+		std::deque<AVPacket> packets;
+	};
+
+	// Keyframe of the indexed stream, pts in its time base
+	struct IndexEntry
+	{
+		int64_t pts;
+		int64_t pos;
+	};
+
+	static std::string indexDirectory;
+
+	LFSIOContext ioContext;
+	AVFormatContext *formatContext;
+
+	love::StrongRef<love::filesystem::File> file;
+	love::StrongRef<love::filesystem::FileData> fileData;
+
+	DemuxThread *demuxThread;
+	// Held while reading or seeking the format context
+	love::thread::MutexRef ioMutex;
+	love::thread::MutexRef mutex;
+	love::thread::ConditionalRef cond;
+
+	// Guarded by ioMutex
+	int indexStream;
+	std::vector<IndexEntry> index;
+	bool indexComplete;
+	// Taken from the container, only seeked by timestamp then
+	bool containerIndex;
+	// Still reading contiguously from the start of the file, so the index
+	// grows. It's complete up to indexedUntil either way.
+	bool indexing;
+	int64_t indexedUntil;
+	std::string indexName;
+	int64_t fileSize;
+	int64_t modTime;
+
+	// Guarded by mutex
+	std::vector<PacketQueue> queues;
+	int serial;
+	// Target of the seek that started serial
+	double seekTarget;
+	int starving;
+	bool eof;
+	bool stopping;
+
+	void initialize(const std::string &filename, int64_t fileSize);
+	void demux();
+	void loadIndex(const std::string &filename, int64_t fileSize);
+	void saveIndex();
+	void addToIndex(const AVPacket &packet);
+	const IndexEntry *findKeyframe(double target) const;
+	void flushQueues();
+	bool isFull(size_t limit) const;
+	void dropPackets(PacketQueue &queue);
+};
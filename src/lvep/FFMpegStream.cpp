@@ -1,25 +1,40 @@
 #include "FFMpegStream.h"
 
-FFMpegStream::FFMpegStream(love::filesystem::File *file, StreamType type)
-	: ioContext(file)
-	, inputFormat(nullptr)
-	, formatContext(nullptr)
-	, codecContext(nullptr)
+FFMpegStream::FFMpegStream(love::filesystem::File *file, StreamType type, int threadCount, ThreadType threadType)
+	: codecContext(nullptr)
+	, targetStream(-1)
+	, serial(0)
+	, type(type)
+	, threadCount(threadCount)
+	, threadType(threadType)
+	, skipTarget(AV_NOPTS_VALUE)
+{
+	demuxer.set(new FFMpegDemuxer(file), love::Acquire::NORETAIN);
+	initialize();
+}
+
+FFMpegStream::FFMpegStream(love::filesystem::FileData *fileData, StreamType type, int threadCount, ThreadType threadType)
+	: codecContext(nullptr)
 	, targetStream(-1)
+	, serial(0)
 	, type(type)
-	, file(file)
+	, threadCount(threadCount)
+	, threadType(threadType)
+	, skipTarget(AV_NOPTS_VALUE)
 {
+	demuxer.set(new FFMpegDemuxer(fileData), love::Acquire::NORETAIN);
 	initialize();
 }
 
-FFMpegStream::FFMpegStream(love::filesystem::FileData *fileData, StreamType type)
-	: ioContext(fileData)
-	, inputFormat(nullptr)
-	, formatContext(nullptr)
+FFMpegStream::FFMpegStream(FFMpegDemuxer *demuxer, StreamType type, int threadCount, ThreadType threadType)
+	: demuxer(demuxer)
 	, codecContext(nullptr)
 	, targetStream(-1)
+	, serial(0)
 	, type(type)
-	, fileData(fileData)
+	, threadCount(threadCount)
+	, threadType(threadType)
+	, skipTarget(AV_NOPTS_VALUE)
 {
 	initialize();
 }
@@ -27,83 +42,156 @@ FFMpegStream::FFMpegStream(love::filesystem::FileData *fileData, StreamType type
 void FFMpegStream::initialize()
 {
 	packet.buf = nullptr;
-	std::string filename = "";
-	if (file.operator love::filesystem::File *()) filename = file->getFilename();
-	else if (fileData.operator love::filesystem::FileData *()) filename = fileData->getFilename();
-
-	try
-	{
-		formatContext = avformat_alloc_context();
-		formatContext->pb = ioContext;
 
-		if (avformat_open_input(&formatContext, filename.c_str(), inputFormat, nullptr) < 0)
-			throw love::Exception("Could not open input stream");
+	AVMediaType targetType = type == TYPE_VIDEO ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO;
+	targetStream = demuxer->findStream(targetType);
 
-		if (avformat_find_stream_info(formatContext, nullptr) < 0)
-			throw love::Exception("Could not find stream information");
+	if (targetStream == -1)
+		throw love::Exception("File does not contain target stream type");
 
-		AVMediaType targetType = type == TYPE_VIDEO ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO;
-		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
-			if (formatContext->streams[i]->codec->codec_type == targetType)
-			{
-				targetStream = i;
-				break;
-			}
+	codecContext = demuxer->getStream(targetStream)->codec;
+	AVCodec *codec = avcodec_find_decoder(codecContext->codec_id);
 
-		if (targetStream == -1)
-			throw love::Exception("File does not contain target stream type");
-
-		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
-			if (i != targetStream)
-				formatContext->streams[i]->discard = AVDISCARD_ALL;
+	// Decoded video frames are ours to keep with av_frame_ref, so
+	// they can be handed over without copying.
+	if (type == TYPE_VIDEO)
+	{
+		codecContext->refcounted_frames = 1;
+		codecContext->thread_count = threadCount > 0 ? threadCount : getDefaultThreadCount();
+		codecContext->thread_type = threadType;
+	}
 
-		codecContext = formatContext->streams[targetStream]->codec;
-		AVCodec *codec = avcodec_find_decoder(codecContext->codec_id);
+	if (avcodec_open2(codecContext, codec, nullptr) < 0)
+		throw love::Exception("Could not open target stream");
 
-		if (avcodec_open2(codecContext, codec, nullptr) < 0)
-			throw love::Exception("Could not open target stream");
+	try
+	{
+		demuxer->enableStream(targetStream);
 	}
 	catch (love::Exception &e)
 	{
-		if (packet.buf)
-			av_packet_unref(&packet);
-		if (codecContext)
-			avcodec_close(codecContext);
-		if (formatContext)
-			avformat_close_input(&formatContext);
-
+		avcodec_close(codecContext);
 		throw e;
 	}
+
+	serial = demuxer->getSerial();
+}
+
+int FFMpegStream::getDefaultThreadCount()
+{
+	int cores = av_cpu_count();
+	if (cores <= 2)
+		return 1;
+
+	// More threads than this only add latency
+	return cores - 1 > 8 ? 8 : cores - 1;
+}
+
+int FFMpegStream::getThreadCount() const
+{
+	return codecContext->active_thread_type ? codecContext->thread_count : 1;
+}
+
+FFMpegStream::ThreadType FFMpegStream::getThreadType() const
+{
+	return (ThreadType) codecContext->active_thread_type;
 }
 
 FFMpegStream::~FFMpegStream()
 {
+	// Or the demuxer keeps queueing for us if it's shared
+	demuxer->disableStream(targetStream);
+
 	if (packet.buf)
 		av_packet_unref(&packet);
 	avcodec_close(codecContext);
-	avformat_close_input(&formatContext);
+}
+
+FFMpegDemuxer *FFMpegStream::getDemuxer() const
+{
+	return demuxer;
+}
+
+AVCodecContext *FFMpegStream::getCodecContext() const
+{
+	return codecContext;
 }
 
 bool FFMpegStream::readPacket()
 {
-	do
-		if (av_read_frame(formatContext, &packet) < 0)
-			return false;
-	while (packet.stream_index != targetStream);
+	if (packet.buf)
+		av_packet_unref(&packet);
+
+	int packetSerial;
+	double seekTarget;
+	if (!demuxer->readPacket(targetStream, &packet, packetSerial, seekTarget))
+		return false;
+
+	// File has been seeked to the keyframe before seekTarget, by us or by
+	// the other stream
+	if (packetSerial != serial)
+	{
+		avcodec_flush_buffers(codecContext);
+		serial = packetSerial;
+		skipUntil(seekTarget);
+	}
+
+	if (type == TYPE_VIDEO && skipTarget != AV_NOPTS_VALUE && packet.pts != AV_NOPTS_VALUE)
+	{
+		// Reference frames are still needed to decode the target
+		if (packet.pts + packet.duration <= skipTarget)
+			codecContext->skip_frame = AVDISCARD_NONREF;
+		else
+		{
+			codecContext->skip_frame = AVDISCARD_DEFAULT;
+			skipTarget = AV_NOPTS_VALUE;
+		}
+	}
 
 	return true;
 }
 
 bool FFMpegStream::readFrame(AVFrame *frame)
+{
+	while (decodeFrame(frame))
+	{
+		// Video skips in readPacket already
+		if (type != TYPE_AUDIO || skipTarget == AV_NOPTS_VALUE || trimFrame(frame))
+			return true;
+	}
+
+	return false;
+}
+
+bool FFMpegStream::decodeFrame(AVFrame *frame)
 {
 	typedef int (*decoder_t)(AVCodecContext*,AVFrame*,int*,const AVPacket*);
 	decoder_t decoder = type == TYPE_VIDEO ? &avcodec_decode_video2 : &avcodec_decode_audio4;
 
+	// Reference counted frames must be released before decoding again.
+	if (codecContext->refcounted_frames)
+		av_frame_unref(frame);
+
 	int got_frame = 0;
 	while (!got_frame)
 	{
 		if (!readPacket())
-			return false;
+		{
+			// Audio decoders don't hold frames
+			if (type != TYPE_VIDEO)
+				return false;
+
+			// End of stream, get the frames the decoder is still holding
+			AVPacket flush;
+			av_init_packet(&flush);
+			flush.data = nullptr;
+			flush.size = 0;
+
+			if (decoder(codecContext, frame, &got_frame, &flush) < 0)
+				return false;
+			return got_frame != 0;
+		}
+
 		if (decoder(codecContext, frame, &got_frame, &packet) < 0)
 			return false;
 	}
@@ -111,21 +199,68 @@ bool FFMpegStream::readFrame(AVFrame *frame)
 	return true;
 }
 
+bool FFMpegStream::trimFrame(AVFrame *frame)
+{
+	int64_t pts = av_frame_get_best_effort_timestamp(frame);
+	int skip = 0;
+
+	if (pts != AV_NOPTS_VALUE)
+		skip = (int) ((translateTimestamp(skipTarget) - translateTimestamp(pts))*frame->sample_rate);
+
+	// Entirely before the target
+	if (skip >= frame->nb_samples)
+		return false;
+
+	skipTarget = AV_NOPTS_VALUE;
+	if (skip <= 0)
+		return true;
+
+	// The decoder owns the samples, so only the pointers are moved.
+	AVSampleFormat format = (AVSampleFormat) frame->format;
+	int planar = av_sample_fmt_is_planar(format);
+	int planes = planar ? frame->channels : 1;
+	int offset = skip*av_get_bytes_per_sample(format)*(planar ? 1 : frame->channels);
+
+	for (int i = 0; i < planes; i++)
+	{
+		frame->extended_data[i] += offset;
+		if (frame->extended_data != frame->data && i < AV_NUM_DATA_POINTERS)
+			frame->data[i] += offset;
+	}
+
+	frame->nb_samples -= skip;
+	return true;
+}
+
 double FFMpegStream::translateTimestamp(int64_t ts) const
 {
-	AVRational &base = formatContext->streams[targetStream]->time_base;
+	AVRational &base = demuxer->getStream(targetStream)->time_base;
 	return (ts*base.num)/double(base.den);
 }
 
 double FFMpegStream::getDuration() const
 {
-	return translateTimestamp(formatContext->streams[targetStream]->duration);
+	return translateTimestamp(demuxer->getStream(targetStream)->duration);
 }
 
 bool FFMpegStream::seek(double target)
 {
-	AVRational &base = formatContext->streams[targetStream]->time_base;
-	int64_t ts = target*base.den/double(base.num);
-	avcodec_flush_buffers(codecContext);
-	return av_seek_frame(formatContext, targetStream, ts, AVSEEK_FLAG_BACKWARD) >= 0;
+	if (!demuxer->ownsSeeking(targetStream))
+		return true;
+
+	// Decoder is flushed and skips to the target when the first packet
+	// after the seek is read
+	serial = -1;
+	return demuxer->seek(target);
+}
+
+void FFMpegStream::skipUntil(double target)
+{
+	AVRational &base = demuxer->getStream(targetStream)->time_base;
+	skipTarget = (int64_t) (target*base.den/double(base.num));
+}
+
+void FFMpegStream::interrupt()
+{
+	demuxer->disableStream(targetStream);
 }
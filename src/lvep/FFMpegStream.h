@@ -1,6 +1,6 @@
 #pragma once
 
-#include "LFSIOContext.h"
+#include "FFMpegDemuxer.h"
 
 // STL
 #include <string>
@@ -16,6 +16,7 @@ extern "C"
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
+#include <libavutil/cpu.h>
 #include <libavutil/pixdesc.h>
 }
 
@@ -28,28 +29,63 @@ public:
 		TYPE_AUDIO,
 	};
 
-	FFMpegStream(love::filesystem::File *file, StreamType type);
-	FFMpegStream(love::filesystem::FileData *fileData, StreamType type);
+	// Decoder threading, as FF_THREAD_* flags
+	enum ThreadType
+	{
+		THREAD_NONE = 0,
+		THREAD_FRAME = FF_THREAD_FRAME,
+		THREAD_SLICE = FF_THREAD_SLICE,
+		THREAD_AUTO = FF_THREAD_FRAME | FF_THREAD_SLICE,
+	};
+
+	// threadCount 0 uses getDefaultThreadCount(). Only used for video.
+	FFMpegStream(love::filesystem::File *file, StreamType type, int threadCount = 0, ThreadType threadType = THREAD_AUTO);
+	FFMpegStream(love::filesystem::FileData *fileData, StreamType type, int threadCount = 0, ThreadType threadType = THREAD_AUTO);
+	// Decode a stream of a demuxer shared with another FFMpegStream
+	FFMpegStream(FFMpegDemuxer *demuxer, StreamType type, int threadCount = 0, ThreadType threadType = THREAD_AUTO);
 	~FFMpegStream();
 
+	FFMpegDemuxer *getDemuxer() const;
+	// Format of the stream, for configuring output before the first frame
+	AVCodecContext *getCodecContext() const;
+
+	// Leaves a core for the game itself
+	static int getDefaultThreadCount();
+	// Threading actually used by the decoder, which depends on the codec
+	int getThreadCount() const;
+	ThreadType getThreadType() const;
+
 	bool readFrame(AVFrame *frame);
 	double translateTimestamp(int64_t ts) const;
 	double getDuration() const;
+	// Ignored, but true, if the demuxer is shared and the other stream
+	// owns seeking. Frames continue from its seeks then.
 	bool seek(double target);
+	// Don't output frames before target (in seconds), for catching up to
+	// it after a seek to the keyframe before it. Video only skips
+	// non-reference frames, audio drops samples.
+	void skipUntil(double target);
+	// Make a readFrame waiting for the demuxer return false, for stopping
+	// the thread decoding. No frames can be read afterwards.
+	void interrupt();
 
 private:
-	LFSIOContext ioContext;
-	AVInputFormat *inputFormat;
-	AVFormatContext *formatContext;
+	love::StrongRef<FFMpegDemuxer> demuxer;
 	AVCodecContext *codecContext;
 	AVPacket packet;
 
 	int targetStream;
+	// Demuxer serial of the packets being decoded
+	int serial;
 	StreamType type;
+	int threadCount;
+	ThreadType threadType;
+	// In stream time base, AV_NOPTS_VALUE when not skipping
+	int64_t skipTarget;
 
-	love::StrongRef<love::filesystem::File> file;
-	love::StrongRef<love::filesystem::FileData> fileData;
-	
 	void initialize();
 	bool readPacket();
+	bool decodeFrame(AVFrame *frame);
+	// Drops audio samples before skipTarget, false if all of them are
+	bool trimFrame(AVFrame *frame);
 };
@@ -9,27 +9,55 @@ LVEPDecoder::LVEPDecoder(love::filesystem::FileData *data, int bufferSize)
 	: love::sound::Decoder(data, data->getExtension(), bufferSize)
 	, stream(data, FFMpegStream::TYPE_AUDIO)
 	, frame(nullptr)
+	, recodeContext(nullptr)
 {
+	initialize();
+}
+
+LVEPDecoder::LVEPDecoder(FFMpegDemuxer *demuxer, const std::string &ext, int bufferSize)
+	: love::sound::Decoder(nullptr, ext, bufferSize)
+	, stream(demuxer, FFMpegStream::TYPE_AUDIO)
+	, frame(nullptr)
+	, recodeContext(nullptr)
+{
+	initialize();
+}
+
+void LVEPDecoder::initialize()
+{
+	// Nothing is read yet, the demuxer may be shared with a video stream
+	// that isn't set up yet.
+	AVCodecContext *codecContext = stream.getCodecContext();
+	channels = codecContext->channels;
+	sampleRate = codecContext->sample_rate;
+	if (channels <= 0 || sampleRate <= 0)
+		throw love::Exception("Unknown audio format");
+
+	channelLayout = codecContext->channel_layout;
+	if (!channelLayout)
+		channelLayout = av_get_default_channel_layout(channels);
+
 	frame = av_frame_alloc();
-	if (!stream.readFrame(frame))
-	{
-		av_frame_free(&frame);
-		throw love::Exception("No first frame");
-	}
+	configure(channelLayout, sampleRate, codecContext->sample_fmt);
+}
 
+void LVEPDecoder::configure(int64_t layout, int rate, AVSampleFormat format)
+{
+	swr_free(&recodeContext);
 	recodeContext = swr_alloc();
-	int channelLayout = frame->channel_layout;
-	if (!channelLayout)
-		channelLayout = av_get_default_channel_layout(frame->channels);
 
-	av_opt_set_int(recodeContext, "in_channel_layout", channelLayout, 0);
-	av_opt_set_int(recodeContext, "in_sample_rate", frame->sample_rate, 0);
-	av_opt_set_sample_fmt(recodeContext, "in_sample_fmt", (AVSampleFormat) frame->format, 0);
+	av_opt_set_int(recodeContext, "in_channel_layout", layout, 0);
+	av_opt_set_int(recodeContext, "in_sample_rate", rate, 0);
+	av_opt_set_sample_fmt(recodeContext, "in_sample_fmt", format, 0);
 
 	av_opt_set_int(recodeContext, "out_channel_layout", channelLayout, 0);
-	av_opt_set_int(recodeContext, "out_sample_rate", frame->sample_rate, 0);
+	av_opt_set_int(recodeContext, "out_sample_rate", sampleRate, 0);
 	av_opt_set_sample_fmt(recodeContext, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
 	swr_init(recodeContext);
+
+	inChannelLayout = layout;
+	inSampleRate = rate;
+	inFormat = format;
 }
 
 LVEPDecoder::~LVEPDecoder()
@@ -61,13 +89,19 @@ int LVEPDecoder::decode()
 		eof = true;
 		return 0;
 	}
+
+	// The codec's format was a guess, or the stream changes format
+	int64_t layout = frame->channel_layout ? frame->channel_layout : av_get_default_channel_layout(frame->channels);
+	if (layout != inChannelLayout || frame->sample_rate != inSampleRate || frame->format != inFormat)
+		configure(layout, frame->sample_rate, (AVSampleFormat) frame->format);
+
 	uint8_t *buffers[2] = {(uint8_t *) buffer, nullptr};
 	int decoded = swr_convert(recodeContext,
-				buffers, (bufferSize >> 1) / frame->channels,
-				(const uint8_t**) &frame->data[0], frame->nb_samples);
+				buffers, (bufferSize >> 1) / channels,
+				(const uint8_t**) frame->extended_data, frame->nb_samples);
 	if (decoded < 0)
 		return 0;
-	return decoded*frame->channels*2;
+	return decoded*channels*2;
 }
 
 bool LVEPDecoder::seek(float s)
@@ -93,7 +127,7 @@ bool LVEPDecoder::isFinished()
 
 int LVEPDecoder::getChannelCount() const
 {
-	return frame->channels;
+	return channels;
 }
 
 int LVEPDecoder::getBitDepth() const
@@ -103,7 +137,7 @@ int LVEPDecoder::getBitDepth() const
 
 int LVEPDecoder::getSampleRate() const
 {
-	return frame->sample_rate;
+	return sampleRate;
 }
 
 double LVEPDecoder::getDuration()
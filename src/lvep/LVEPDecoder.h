@@ -17,6 +17,8 @@ class LVEPDecoder : public love::sound::Decoder
 public:
 	LVEPDecoder(love::filesystem::FileData *data, int bufferSize);
 	LVEPDecoder(love::Data *data, const std::string &ext, int bufferSize);
+	// Decode audio of a demuxer shared with a LVEPVideoStream
+	LVEPDecoder(FFMpegDemuxer *demuxer, const std::string &ext, int bufferSize);
 	virtual ~LVEPDecoder();
 
 	love::sound::Decoder *clone();
@@ -37,4 +39,16 @@ private:
 	AVFrame *frame;
 	SwrContext *recodeContext;
 	love::StrongRef<love::filesystem::File> file;
+
+	// Output format, taken from the codec
+	int64_t channelLayout;
+	int channels;
+	int sampleRate;
+	// Input format swr is configured for
+	int64_t inChannelLayout;
+	int inSampleRate;
+	AVSampleFormat inFormat;
+
+	void initialize();
+	void configure(int64_t layout, int rate, AVSampleFormat format);
 };
@@ -2,13 +2,33 @@
 
 #include <timer/Timer.h>
 
-LVEPVideoStream::LVEPVideoStream(love::filesystem::File *file)
-	: stream(new FFMpegStream(file, FFMpegStream::TYPE_VIDEO))
+LVEPVideoStream::DecodeThread::DecodeThread(LVEPVideoStream *stream)
+	: stream(stream)
+{
+	threadName = "LVEPVideoDecoder";
+}
+
+void LVEPVideoStream::DecodeThread::threadFunction()
+{
+	stream->decode();
+}
+
+LVEPVideoStream::LVEPVideoStream(love::filesystem::File *file, int threadCount, FFMpegStream::ThreadType threadType, FFMpegDemuxer *demuxer)
+	: stream(demuxer
+		? new FFMpegStream(demuxer, FFMpegStream::TYPE_VIDEO, threadCount, threadType)
+		: new FFMpegStream(file, FFMpegStream::TYPE_VIDEO, threadCount, threadType))
 	, file(file)
-	, dirty(false)
+	, decodeThread(nullptr)
+	, clock(0)
+	, seekRequested(false)
+	, seekTarget(0)
+	, generation(0)
 	, eos(false)
+	, stopping(false)
+	, dirty(false)
 	, previousTime(0)
 	, previousFrame(0)
+	, backBuffer(nullptr)
 {
 	frame = av_frame_alloc();
 	if (!stream->readFrame(frame))
@@ -18,8 +38,20 @@ LVEPVideoStream::LVEPVideoStream(love::filesystem::File *file)
 		throw love::Exception("No first frame");
 	}
 
-	frontBuffer = allocateBuffer();
-	backBuffer = allocateBuffer();
+	width = frame->width;
+	height = frame->height;
+	decoderThreadCount = stream->getThreadCount();
+	decoderThreadType = stream->getThreadType();
+
+	// One for the front buffer, one for the back buffer, and the rest
+	// is for the queue. The front buffer shows the first frame until
+	// the first swap.
+	frontBuffer = new FrameRef(width, height);
+	frontBuffer->set(frame);
+	freeFrames.reserve(FRAME_QUEUE_SIZE + 1);
+	readyFrames.reserve(FRAME_QUEUE_SIZE + 1);
+	for (int i = 0; i <= FRAME_QUEUE_SIZE; i++)
+		freeFrames.push_back(new FrameRef(width, height));
 
 	// frameSync is a StrongRef, so it retains itself, so after set it has a reference
 	// count of 2, rather than 1
@@ -27,43 +59,89 @@ LVEPVideoStream::LVEPVideoStream(love::filesystem::File *file)
 	frameSync->release();
 
 	previousTime = love::timer::Timer::getTime();
+
+	decodeThread = new DecodeThread(this);
+	decodeThread->start();
 }
 
 LVEPVideoStream::~LVEPVideoStream()
 {
+	{
+		love::thread::Lock l(mutex);
+		stopping = true;
+		cond->broadcast();
+	}
+
+	// It may be waiting for packets from the demuxer
+	stream->interrupt();
+	decodeThread->wait();
+	decodeThread->release();
+
+	for (size_t i = 0; i < readyFrames.size(); i++)
+		delete readyFrames[i].buffer;
+	for (size_t i = 0; i < freeFrames.size(); i++)
+		delete freeFrames[i];
+
 	av_frame_free(&frame);
 	delete frontBuffer;
 	delete backBuffer;
 	delete stream;
 }
 
-love::video::VideoStream::Frame *LVEPVideoStream::allocateBuffer()
+LVEPVideoStream::FrameRef::FrameRef(int width, int height)
+	: frame(av_frame_alloc())
 {
-	love::video::VideoStream::Frame *buffer;
-	buffer = new love::video::VideoStream::Frame();
-	buffer->yw = getWidth();
-	buffer->yh = getHeight();
+	yw = width;
+	yh = height;
 
 	// TODO: Format support (non yuv420p)
 	// swrast to recode?
-	buffer->cw = getWidth()/2;
-	buffer->ch = getHeight()/2;
+	cw = width/2;
+	ch = height/2;
+}
+
+LVEPVideoStream::FrameRef::~FrameRef()
+{
+	av_frame_free(&frame);
+
+	// Planes belong to the AVFrame
+	yplane = cbplane = crplane = nullptr;
+}
+
+bool LVEPVideoStream::FrameRef::set(const AVFrame *source)
+{
+	av_frame_unref(frame);
+	yplane = cbplane = crplane = nullptr;
 
-	buffer->yplane = new unsigned char[buffer->yw*buffer->yh];
-	buffer->cbplane = new unsigned char[buffer->cw*buffer->ch];
-	buffer->crplane = new unsigned char[buffer->cw*buffer->ch];
+	if (av_frame_ref(frame, source) < 0)
+		return false;
+
+	yplane = frame->data[0];
+	cbplane = frame->data[1];
+	crplane = frame->data[2];
+	ystride = frame->linesize[0];
+	cstride = frame->linesize[1];
+	return true;
+}
+
+int LVEPVideoStream::getDecoderThreadCount() const
+{
+	return decoderThreadCount;
+}
 
-	return buffer;
+FFMpegStream::ThreadType LVEPVideoStream::getDecoderThreadType() const
+{
+	return decoderThreadType;
 }
 
 int LVEPVideoStream::getWidth() const
 {
-	return frame->width;
+	return width;
 }
 
 int LVEPVideoStream::getHeight() const
 {
-	return frame->height;
+	return height;
 }
 
 const std::string &LVEPVideoStream::getFilename() const
@@ -80,57 +158,45 @@ void LVEPVideoStream::fillBackBuffer()
 	frameSync->update(dt);
 	double time = frameSync->getPosition();
 
-	// If we've drawn a frame past the current timestamp, we must have rewound
+	love::thread::Lock l(mutex);
+	clock = time;
+
+	// If we've picked a frame past the current timestamp, we must have rewound
 	if (time < previousFrame)
 	{
-		stream->seek(time);
-		stream->readFrame(frame);
+		for (size_t i = 0; i < readyFrames.size(); i++)
+			freeFrames.push_back(readyFrames[i].buffer);
+		readyFrames.clear();
 
-		// Now we're at the keyframe before our target, look for the actual frame
-		tinySeek(time);
+		seekRequested = true;
+		seekTarget = time;
+		generation++;
 		eos = false;
+		previousFrame = time;
+		cond->broadcast();
+		return;
 	}
 
-	if (eos)
-		return;
+	// Pick the latest frame which is due, drop the older ones.
+	size_t due = 0;
+	while (due < readyFrames.size() && readyFrames[due].pts <= time)
+		due++;
 
-	double pts = stream->translateTimestamp(frame->pkt_pts);
-	if (time < pts)
+	if (due == 0)
 		return;
 
-	if (time > pts+15) // We're far behind, do a large seek
-	{
-		stream->seek(time);
-		stream->readFrame(frame);
-	}
-	if (time > pts+0.2) // We're a bit behind, do a tiny seek
-		tinySeek(time);
+	for (size_t i = 0; i < due - 1; i++)
+		freeFrames.push_back(readyFrames[i].buffer);
 
-	dirty = true;
-	previousFrame = pts;
-
-	// A note, simple memcpy won't work due to alignment.
-	int videoWidth = getWidth();
-	int videoHeight = getHeight();
-	int j = 0;
-	// Y first
-	for (int i = 0; i < videoHeight; i++)
-	{
-		memcpy(backBuffer->yplane + (i * videoWidth), &frame->data[0][j], videoWidth);
-		j += frame->linesize[0];
-	}
-	// Then U & V
-	j = 0;
-	for (int i = 0; i < (videoHeight >> 1); i++)
-	{
-		int k = (i * (videoWidth >> 1));
-		memcpy(backBuffer->cbplane + k, &frame->data[1][j], videoWidth >> 1);
-		memcpy(backBuffer->crplane + k, &frame->data[2][j], videoWidth >> 1);
-		j += frame->linesize[1];
-	}
+	// Previously picked frame which hasn't been swapped is replaced.
+	if (backBuffer)
+		freeFrames.push_back(backBuffer);
 
-	if (!stream->readFrame(frame))
-		eos = true;
+	backBuffer = readyFrames[due - 1].buffer;
+	previousFrame = readyFrames[due - 1].pts;
+	readyFrames.erase(readyFrames.begin(), readyFrames.begin() + due);
+	dirty = true;
+	cond->broadcast();
 }
 
 const void *LVEPVideoStream::getFrontBuffer() const
@@ -148,10 +214,12 @@ bool LVEPVideoStream::swapBuffers()
 	if (!dirty)
 		return false;
 
+	love::thread::Lock l(mutex);
 	dirty = false;
-	love::video::VideoStream::Frame *temp = frontBuffer;
+	freeFrames.push_back(frontBuffer);
 	frontBuffer = backBuffer;
-	backBuffer = temp;
+	backBuffer = nullptr;
+	cond->broadcast();
 	return true;
 }
 
@@ -167,8 +235,77 @@ void LVEPVideoStream::pause()
 	return this->love::video::VideoStream::pause();
 }
 
-void LVEPVideoStream::tinySeek(double target)
+void LVEPVideoStream::decode()
+{
+	mutex->lock();
+
+	while (!stopping)
+	{
+		if (seekRequested)
+		{
+			double target = seekTarget;
+			seekRequested = false;
+			mutex->unlock();
+
+			// Land on the keyframe before our target, then look for the actual frame
+			stream->seek(target);
+			bool more = stream->readFrame(frame) && tinySeek(target);
+
+			mutex->lock();
+			if (!seekRequested)
+				eos = !more;
+			continue;
+		}
+
+		if (eos || freeFrames.empty())
+		{
+			cond->wait(mutex);
+			continue;
+		}
+
+		FrameRef *buffer = freeFrames.back();
+		freeFrames.pop_back();
+		int decodeGeneration = generation;
+		double target = clock;
+		mutex->unlock();
+
+		// Frames which would never be shown are skipped.
+		bool more = true;
+		if (target > stream->translateTimestamp(frame->pkt_pts)+15) // We're far behind, do a large seek
+		{
+			stream->seek(target);
+			more = stream->readFrame(frame);
+		}
+		if (more)
+			more = tinySeek(target);
+
+		double pts = stream->translateTimestamp(frame->pkt_pts);
+		bool ready = more && buffer->set(frame);
+		if (more)
+			more = stream->readFrame(frame);
+
+		mutex->lock();
+		if (ready && decodeGeneration == generation)
+		{
+			QueuedFrame queued = {buffer, pts};
+			readyFrames.push_back(queued);
+		}
+		else
+			freeFrames.push_back(buffer);
+
+		if (decodeGeneration == generation)
+			eos = !more;
+	}
+
+	mutex->unlock();
+}
+
+bool LVEPVideoStream::tinySeek(double target)
 {
+	stream->skipUntil(target);
 	while (target > stream->translateTimestamp(frame->pkt_pts + frame->pkt_duration))
-		stream->readFrame(frame);
+		if (!stream->readFrame(frame))
+			return false;
+
+	return true;
 }
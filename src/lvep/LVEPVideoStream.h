@@ -1,9 +1,13 @@
 #pragma once
 
+// STL
+#include <vector>
+
 // LOVE
 #include <common/Object.h>
 #include <video/VideoStream.h>
 #include <filesystem/File.h>
+#include <thread/threads.h>
 
 // FFMPEG
 extern "C"
@@ -16,12 +20,25 @@ extern "C"
 
 #include "FFMpegStream.h"
 
+// Video is decoded by a worker thread, which keeps up to FRAME_QUEUE_SIZE
+// frames decoded ahead of the playback position. fillBackBuffer and
+// swapBuffers only pick a ready frame, so they never wait for decoding.
+// Frames reference the decoder's buffers, which are uploaded with their
+// stride, so pixels are never copied.
 class LVEPVideoStream : public love::video::VideoStream
 {
 public:
-	LVEPVideoStream(love::filesystem::File *file);
+	static const int FRAME_QUEUE_SIZE = 4;
+
+	// With demuxer, the video of a demuxer shared with a LVEPDecoder is
+	// decoded, otherwise file is demuxed by the stream itself.
+	LVEPVideoStream(love::filesystem::File *file, int threadCount = 0, FFMpegStream::ThreadType threadType = FFMpegStream::THREAD_AUTO, FFMpegDemuxer *demuxer = nullptr);
 	virtual ~LVEPVideoStream();
 
+	// Threading used by the codec, for tuning
+	int getDecoderThreadCount() const;
+	FFMpegStream::ThreadType getDecoderThreadType() const;
+
 	virtual int getWidth() const;
 	virtual int getHeight() const;
 	virtual const std::string &getFilename() const;
@@ -33,18 +50,64 @@ public:
 	virtual void play();
 
 private:
+	class DecodeThread : public love::thread::Threadable
+	{
+	public:
+		DecodeThread(LVEPVideoStream *stream);
+		void threadFunction();
+
+	private:
+		LVEPVideoStream *stream;
+	};
+
+	// Frame whose planes are in a referenced AVFrame rather than owned
+	struct FrameRef : public love::video::VideoStream::Frame
+	{
+		FrameRef(int width, int height);
+		~FrameRef();
+		bool set(const AVFrame *source);
+
+		AVFrame *frame;
+	};
+
+	struct QueuedFrame
+	{
+		FrameRef *buffer;
+		double pts;
+	};
+
+	// Only used by the decode thread after construction
 	FFMpegStream *stream;
+	AVFrame *frame;
+
 	love::StrongRef<love::filesystem::File> file;
+	int width;
+	int height;
+	int decoderThreadCount;
+	FFMpegStream::ThreadType decoderThreadType;
 
-	AVFrame *frame;
-	bool dirty;
+	DecodeThread *decodeThread;
+	love::thread::MutexRef mutex;
+	love::thread::ConditionalRef cond;
+
+	// Guarded by mutex
+	std::vector<QueuedFrame> readyFrames;
+	std::vector<FrameRef*> freeFrames;
+	double clock;
+	bool seekRequested;
+	double seekTarget;
+	// Incremented on seek, so frames decoded before it are dropped
+	int generation;
 	bool eos;
+	bool stopping;
+
+	// Only used by the thread which plays the video
+	bool dirty;
 	double previousTime;
 	double previousFrame;
+	FrameRef *frontBuffer;
+	FrameRef *backBuffer;
 
-	love::video::VideoStream::Frame *frontBuffer;
-	love::video::VideoStream::Frame *backBuffer;
-
-	love::video::VideoStream::Frame *allocateBuffer();
-	void tinySeek(double target);
+	void decode();
+	bool tinySeek(double target);
 };
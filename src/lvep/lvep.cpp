@@ -20,9 +20,14 @@ extern "C"
 #include "LVEPVideoStream.h"
 #include "LVEPDecoder.h"
 
+static const char *threadTypeNames[] = {"none", "frame", "slice", "auto", nullptr};
+
 int w_newVideoStream(lua_State *L)
 {
 	love::filesystem::File *file = love::filesystem::luax_getfile(L, 1);
+	// Decoder threads, 0 to derive from core count
+	int threadCount = (int) luaL_optinteger(L, 2, 0);
+	FFMpegStream::ThreadType threadType = (FFMpegStream::ThreadType) luaL_checkoption(L, 3, "auto", threadTypeNames);
 
 	love::video::VideoStream *stream = nullptr;
 	love::luax_catchexcept(L, [&]() {
@@ -30,7 +35,7 @@ int w_newVideoStream(lua_State *L)
 		if (!file->isOpen() && !file->open(love::filesystem::File::MODE_READ))
 			luaL_error(L, "File is not open and cannot be opened");
 
-		stream = new LVEPVideoStream(file);
+		stream = new LVEPVideoStream(file, threadCount, threadType);
 	});
 
 	luax_pushtype(L, stream);
@@ -38,6 +43,70 @@ int w_newVideoStream(lua_State *L)
 	return 1;
 }
 
+// Video and optional audio of one file, sharing a demuxer so the file is
+// read once. Returns VideoStream and Decoder, or nil if there's no audio.
+int w_newVideo(lua_State *L)
+{
+	love::filesystem::File *file = love::filesystem::luax_getfile(L, 1);
+	int threadCount = (int) luaL_optinteger(L, 2, 0);
+	FFMpegStream::ThreadType threadType = (FFMpegStream::ThreadType) luaL_checkoption(L, 3, "auto", threadTypeNames);
+	int bufferSize = (int) luaL_optinteger(L, 4, love::sound::Decoder::DEFAULT_BUFFER_SIZE);
+
+	love::video::VideoStream *stream = nullptr;
+	love::sound::Decoder *decoder = nullptr;
+	love::luax_catchexcept(L,
+		[&]() {
+			// Can't check if open for reading
+			if (!file->isOpen() && !file->open(love::filesystem::File::MODE_READ))
+				luaL_error(L, "File is not open and cannot be opened");
+
+			// Audio first, the video reads its first frame right away and
+			// the demuxer only queues the streams enabled by then.
+			love::StrongRef<FFMpegDemuxer> demuxer(new FFMpegDemuxer(file), love::Acquire::NORETAIN);
+			if (demuxer->findStream(AVMEDIA_TYPE_AUDIO) != -1)
+				decoder = new LVEPDecoder(demuxer, file->getExtension(), bufferSize);
+
+			stream = new LVEPVideoStream(file, threadCount, threadType, demuxer);
+		},
+		[&](bool failed) {
+			if (failed && decoder)
+				decoder->release();
+		}
+	);
+
+	luax_pushtype(L, stream);
+	stream->release();
+
+	if (decoder)
+	{
+		luax_pushtype(L, decoder);
+		decoder->release();
+	}
+	else
+		lua_pushnil(L);
+
+	return 2;
+}
+
+int w_getDecoderThreads(lua_State *L)
+{
+	love::video::VideoStream *stream = love::luax_checktype<love::video::VideoStream>(L, 1);
+	LVEPVideoStream *lvepStream = dynamic_cast<LVEPVideoStream*>(stream);
+	if (lvepStream == nullptr)
+		return luaL_argerror(L, 1, "not a LVEP video stream");
+
+	lua_pushinteger(L, lvepStream->getDecoderThreadCount());
+	lua_pushstring(L, threadTypeNames[lvepStream->getDecoderThreadType()]);
+	return 2;
+}
+
+int w_setIndexDirectory(lua_State *L)
+{
+	// nil or no argument disables persisting keyframe indices
+	FFMpegDemuxer::setIndexDirectory(luaL_optstring(L, 1, ""));
+	return 0;
+}
+
 int w_newDecoder(lua_State *L)
 {
 	love::filesystem::FileData *data = love::filesystem::luax_getfiledata(L, 1);
@@ -65,6 +134,12 @@ extern "C" int luaopen_lvep(lua_State *L)
 	lua_newtable(L);
 	lua_pushcfunction(L, w_newVideoStream);
 	lua_setfield(L, -2, "newVideoStream");
+	lua_pushcfunction(L, w_newVideo);
+	lua_setfield(L, -2, "newVideo");
+	lua_pushcfunction(L, w_getDecoderThreads);
+	lua_setfield(L, -2, "getDecoderThreads");
+	lua_pushcfunction(L, w_setIndexDirectory);
+	lua_setfield(L, -2, "setIndexDirectory");
 	lua_pushcfunction(L, w_newDecoder);
 	lua_setfield(L, -2, "newDecoder");
 	return 1;
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// love
+#include "common/config.h"
+#include "common/Exception.h"
+
+#ifdef LOVE_WINDOWS
+#include "common/utf8.h"
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// MappedFile
+#include "MappedFile.h"
+
+namespace livesim
+{
+namespace pack
+{
+
+#ifdef LOVE_WINDOWS
+
+MappedFile::MappedFile(const std::string &path)
+	: path(path)
+	, data(nullptr)
+	, size(0)
+	, fileHandle(INVALID_HANDLE_VALUE)
+	, mappingHandle(nullptr)
+{
+	std::wstring wpath = love::to_widestr(path);
+	HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw love::Exception("Could not open %s", path.c_str());
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (uint64_t) fileSize.QuadPart > SIZE_MAX)
+	{
+		CloseHandle(file);
+		throw love::Exception("Could not map %s: invalid size", path.c_str());
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		throw love::Exception("Could not map %s", path.c_str());
+	}
+
+	data = (const uint8_t *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw love::Exception("Could not map %s", path.c_str());
+	}
+
+	size = (size_t) fileSize.QuadPart;
+	fileHandle = file;
+	mappingHandle = mapping;
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+	: path(path)
+	, data(nullptr)
+	, size(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw love::Exception("Could not open %s", path.c_str());
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size <= 0)
+	{
+		close(fd);
+		throw love::Exception("Could not map %s: invalid size", path.c_str());
+	}
+
+	void *ptr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+		throw love::Exception("Could not map %s", path.c_str());
+
+	data = (const uint8_t *) ptr;
+	size = (size_t) st.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+	munmap((void *) data, size);
+}
+
+#endif
+
+const uint8_t *MappedFile::getData() const
+{
+	return data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return size;
+}
+
+const std::string &MappedFile::getPath() const
+{
+	return path;
+}
+
+MappedData::MappedData(MappedFile *file, size_t offset, size_t size)
+	: file(file)
+	, offset(offset)
+	, size(size)
+{
+	if (offset > file->getSize() || size > file->getSize() - offset)
+		throw love::Exception("Mapped data out of range");
+
+	file->retain();
+}
+
+MappedData::~MappedData()
+{
+	file->release();
+}
+
+MappedData *MappedData::clone() const
+{
+	// Still read-only, so sharing the mapping is fine.
+	return new MappedData(file, offset, size);
+}
+
+void *MappedData::getData() const
+{
+	return (void *) (file->getData() + offset);
+}
+
+size_t MappedData::getSize() const
+{
+	return size;
+}
+
+} // pack
+} // livesim
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_PACK_MAPPEDFILE_H
+#define LIVESIM_PACK_MAPPEDFILE_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// love
+#include "common/Data.h"
+#include "common/Object.h"
+
+namespace livesim
+{
+namespace pack
+{
+
+/* Read-only memory mapping of whole file. */
+class MappedFile: public love::Object
+{
+public:
+	/**
+	 * Map file to memory.
+	 *
+	 * @param path Native path to the file, UTF-8 encoded.
+	 * @throws love::Exception if the file can't be opened or mapped.
+	 */
+	MappedFile(const std::string &path);
+	~MappedFile();
+	/**
+	 * Get pointer to the mapped file contents.
+	 *
+	 * @return Pointer to the start of the file.
+	 */
+	const uint8_t *getData() const;
+	/**
+	 * Get size of the file.
+	 *
+	 * @return File size in bytes.
+	 */
+	size_t getSize() const;
+	/**
+	 * Get path of the mapped file.
+	 *
+	 * @return Native path, as passed to the constructor.
+	 */
+	const std::string &getPath() const;
+
+private:
+	std::string path;
+	const uint8_t *data;
+	size_t size;
+#ifdef LOVE_WINDOWS
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+};
+
+/**
+ * Data which points into a MappedFile without copying. The mapping is
+ * read-only, so the data must not be modified.
+ */
+class MappedData: public love::Data
+{
+public:
+	/**
+	 * Create new view to mapped file.
+	 *
+	 * @param file The mapped file. Retained while this object lives.
+	 * @param offset Offset from start of the file.
+	 * @param size Size of the view.
+	 */
+	MappedData(MappedFile *file, size_t offset, size_t size);
+	~MappedData();
+
+	MappedData *clone() const;
+	void *getData() const;
+	size_t getSize() const;
+
+private:
+	MappedFile *file;
+	size_t offset;
+	size_t size;
+};
+
+} // pack
+} // livesim
+
+#endif
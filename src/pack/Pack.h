@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_PACK_PACK_H
+#define LIVESIM_PACK_PACK_H
+
+// std
+#include <cstdint>
+#include <string>
+
+// love
+#include "common/Data.h"
+
+namespace livesim
+{
+namespace pack
+{
+
+/*
+ * Pack layout. All integers are little-endian and all offsets are relative
+ * to the start of the pack, which is 16-byte aligned within its file.
+ *
+ * PackHeader
+ * File data, each file 16-byte aligned, stored or LZ4 compressed
+ * PackEntry[fileCount], sorted by hash then name
+ * File names, not NUL-terminated
+ * PackTrailer
+ *
+ * The trailer is at the very end of the file, so a pack can be appended
+ * to the executable for fused mode.
+ */
+
+const char PACK_MAGIC[4] = {'L', 'S', 'P', 'K'};
+const char PACK_TRAILER_MAGIC[8] = {'L', 'S', 'P', 'K', 'E', 'N', 'D', 0};
+const uint32_t PACK_VERSION = 1;
+const size_t PACK_ALIGNMENT = 16;
+
+enum PackCompression
+{
+	PACK_STORED = 0,
+	PACK_LZ4 = 1
+};
+
+struct PackHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t fileCount;
+	uint32_t reserved;
+	uint64_t indexOffset;
+	uint64_t namesOffset;
+};
+
+struct PackEntry
+{
+	// XXH64 of the file name, seed 0
+	uint64_t hash;
+	uint64_t offset;
+	// Uncompressed size
+	uint64_t size;
+	// Size in the pack
+	uint64_t packedSize;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t compression;
+	uint32_t reserved;
+};
+
+struct PackTrailer
+{
+	// Size of the whole pack, including this trailer.
+	uint64_t packSize;
+	char magic[8];
+};
+
+/**
+ * Register the pack archiver to PhysFS, so PHYSFS_mount (and
+ * love.filesystem.setSource) can mount packs. Must be called after
+ * PHYSFS_init.
+ *
+ * @return true on success.
+ */
+bool registerArchiver();
+/**
+ * Get file contents directly from mounted pack, without copying.
+ * Safe to call from any thread.
+ *
+ * @param filename File name in PhysFS notation.
+ * @return New Data pointing into the mapping, or nullptr if the file is
+ *         not in a pack or is compressed.
+ */
+love::Data *getMappedData(const std::string &filename);
+/**
+ * Write every file in directory to a pack. If the output file exists,
+ * the pack is appended to it, e.g. to create fused executable.
+ *
+ * @param directory Native path to the directory.
+ * @param output Native path to the output file.
+ * @param compress Use LZ4 for files which compress well.
+ * @return true on success.
+ */
+bool packDirectory(const std::string &directory, const std::string &output, bool compress = true);
+
+} // pack
+} // livesim
+
+#endif
@@ -0,0 +1,523 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+// love
+#include "common/Exception.h"
+#include "libraries/lz4/lz4.h"
+#include "libraries/physfs/physfs.h"
+#include "libraries/xxHash/xxhash.h"
+#include "modules/thread/threads.h"
+
+// Pack
+#include "MappedFile.h"
+#include "Pack.h"
+
+namespace livesim
+{
+namespace pack
+{
+
+// Mounted pack
+class Archive: public love::Object
+{
+public:
+	Archive(MappedFile *file, PHYSFS_Io *io, const std::string &name)
+		: file(file)
+		, io(io)
+		, name(name)
+	{
+		file->retain();
+	}
+
+	~Archive()
+	{
+		file->release();
+
+		if (io)
+			io->destroy(io);
+	}
+
+	MappedFile *file;
+	PHYSFS_Io *io;
+	// Name given to PHYSFS_mount, also returned by PHYSFS_getRealDir
+	std::string name;
+	// Offset of the pack in the mapped file
+	size_t base;
+	const PackEntry *entries;
+	uint32_t fileCount;
+	const char *names;
+	// Directory name to its children
+	std::map<std::string, std::set<std::string>> directories;
+
+	std::string getName(const PackEntry &e) const
+	{
+		return std::string(names + e.nameOffset, e.nameLength);
+	}
+
+	const uint8_t *getData(const PackEntry &e) const
+	{
+		return file->getData() + base + e.offset;
+	}
+
+	const PackEntry *find(const std::string &filename) const
+	{
+		uint64_t hash = XXH64(filename.data(), filename.length(), 0);
+		const PackEntry *end = entries + fileCount;
+		const PackEntry *e = std::lower_bound(entries, end, hash, [](const PackEntry &a, uint64_t h)
+		{
+			return a.hash < h;
+		});
+
+		// Hash collision is possible, so also compare the name
+		for (; e != end && e->hash == hash; e++)
+		{
+			if (e->nameLength == filename.length() && memcmp(names + e->nameOffset, filename.data(), filename.length()) == 0)
+				return e;
+		}
+
+		return nullptr;
+	}
+};
+
+// Open file in a pack
+struct PackIo
+{
+	Archive *archive;
+	const PackEntry *entry;
+	const uint8_t *data;
+	uint64_t pos;
+	// Only used by compressed files
+	std::vector<uint8_t> decompressed;
+};
+
+// Mounted packs, for getMappedData
+static love::thread::MutexRef archivesMutex;
+static std::vector<Archive *> archives;
+
+static PHYSFS_sint64 ioRead(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+	PackIo *p = (PackIo *) io->opaque;
+	uint64_t left = p->entry->size - p->pos;
+	uint64_t amount = std::min(left, (uint64_t) len);
+
+	memcpy(buf, p->data + p->pos, (size_t) amount);
+	p->pos += amount;
+	return (PHYSFS_sint64) amount;
+}
+
+static PHYSFS_sint64 ioWrite(PHYSFS_Io *, const void *, PHYSFS_uint64)
+{
+	PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+	return -1;
+}
+
+static int ioSeek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+	PackIo *p = (PackIo *) io->opaque;
+
+	if (offset > p->entry->size)
+	{
+		PHYSFS_setErrorCode(PHYSFS_ERR_PAST_EOF);
+		return 0;
+	}
+
+	p->pos = offset;
+	return 1;
+}
+
+static PHYSFS_sint64 ioTell(PHYSFS_Io *io)
+{
+	return (PHYSFS_sint64) ((PackIo *) io->opaque)->pos;
+}
+
+static PHYSFS_sint64 ioLength(PHYSFS_Io *io)
+{
+	return (PHYSFS_sint64) ((PackIo *) io->opaque)->entry->size;
+}
+
+static PHYSFS_Io *newIo(Archive *archive, const PackEntry *entry);
+
+static PHYSFS_Io *ioDuplicate(PHYSFS_Io *io)
+{
+	PackIo *p = (PackIo *) io->opaque;
+	return newIo(p->archive, p->entry);
+}
+
+static int ioFlush(PHYSFS_Io *)
+{
+	return 1;
+}
+
+static void ioDestroy(PHYSFS_Io *io)
+{
+	PackIo *p = (PackIo *) io->opaque;
+	p->archive->release();
+	delete p;
+	delete io;
+}
+
+static PHYSFS_Io *newIo(Archive *archive, const PackEntry *entry)
+{
+	PackIo *p = new (std::nothrow) PackIo();
+	if (p == nullptr)
+	{
+		PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+		return nullptr;
+	}
+
+	p->archive = archive;
+	p->entry = entry;
+	p->pos = 0;
+	p->data = archive->getData(*entry);
+
+	if (entry->compression == PACK_LZ4)
+	{
+		// LZ4 blocks are small and fast to decode, so decompress the
+		// whole file now instead of streaming.
+		try
+		{
+			p->decompressed.resize((size_t) entry->size);
+		}
+		catch (std::bad_alloc &)
+		{
+			delete p;
+			PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+			return nullptr;
+		}
+
+		int result = LZ4_decompress_safe((const char *) p->data, (char *) p->decompressed.data(), (int) entry->packedSize, (int) entry->size);
+		if (result < 0 || (uint64_t) result != entry->size)
+		{
+			delete p;
+			PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+			return nullptr;
+		}
+
+		p->data = p->decompressed.data();
+	}
+
+	PHYSFS_Io *io = new (std::nothrow) PHYSFS_Io();
+	if (io == nullptr)
+	{
+		delete p;
+		PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+		return nullptr;
+	}
+
+	io->version = 0;
+	io->opaque = p;
+	io->read = ioRead;
+	io->write = ioWrite;
+	io->seek = ioSeek;
+	io->tell = ioTell;
+	io->length = ioLength;
+	io->duplicate = ioDuplicate;
+	io->flush = ioFlush;
+	io->destroy = ioDestroy;
+
+	archive->retain();
+	return io;
+}
+
+// Check the pack structure, so later lookups don't need bounds checks.
+static bool setupArchive(Archive *archive)
+{
+	const uint8_t *data = archive->file->getData();
+	size_t size = archive->file->getSize();
+
+	if (size < sizeof(PackHeader) + sizeof(PackTrailer))
+		return false;
+
+	PackTrailer trailer;
+	memcpy(&trailer, data + size - sizeof(PackTrailer), sizeof(PackTrailer));
+	if (memcmp(trailer.magic, PACK_TRAILER_MAGIC, sizeof(trailer.magic)) != 0)
+		return false;
+
+	// Header and trailer must fit, and the writer aligns the pack start
+	uint64_t packSize = trailer.packSize;
+	if (packSize > size || packSize < sizeof(PackHeader) + sizeof(PackTrailer) || (size - packSize) % PACK_ALIGNMENT != 0)
+		return false;
+
+	archive->base = (size_t) (size - packSize);
+
+	const PackHeader *header = (const PackHeader *) (data + archive->base);
+	if (memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) != 0 || header->version != PACK_VERSION)
+		return false;
+
+	// Index and names are between the header and the trailer
+	uint64_t dataEnd = packSize - sizeof(PackTrailer);
+	uint64_t indexSize = (uint64_t) header->fileCount * sizeof(PackEntry);
+	if (header->indexOffset < sizeof(PackHeader) || header->indexOffset > dataEnd || header->indexOffset % PACK_ALIGNMENT != 0 ||
+		indexSize > dataEnd - header->indexOffset)
+		return false;
+	if (header->namesOffset < sizeof(PackHeader) || header->namesOffset > dataEnd)
+		return false;
+
+	archive->entries = (const PackEntry *) (data + archive->base + header->indexOffset);
+	archive->fileCount = header->fileCount;
+	archive->names = (const char *) (data + archive->base + header->namesOffset);
+
+	uint64_t namesSize = dataEnd - header->namesOffset;
+
+	for (uint32_t i = 0; i < archive->fileCount; i++)
+	{
+		const PackEntry &e = archive->entries[i];
+
+		if (e.offset > dataEnd || e.packedSize > dataEnd - e.offset)
+			return false;
+		if ((uint64_t) e.nameOffset + e.nameLength > namesSize)
+			return false;
+		if (e.compression == PACK_STORED ? e.packedSize != e.size : e.compression != PACK_LZ4)
+			return false;
+
+		// Register every parent directory
+		std::string name = archive->getName(e);
+		size_t slash = name.rfind('/');
+
+		while (true)
+		{
+			std::string parent = slash == std::string::npos ? std::string() : name.substr(0, slash);
+			std::string child = slash == std::string::npos ? name : name.substr(slash + 1);
+
+			auto &children = archive->directories[parent];
+			bool known = !children.empty() && parent != name;
+			children.insert(child);
+
+			if (parent.empty() || known)
+				break;
+
+			name = parent;
+			slash = name.rfind('/');
+		}
+	}
+
+	return true;
+}
+
+static void *openArchive(PHYSFS_Io *io, const char *name, int forWrite, int *claimed)
+{
+	PackTrailer trailer;
+	PHYSFS_sint64 length = io->length(io);
+
+	if (forWrite || length < (PHYSFS_sint64) (sizeof(PackHeader) + sizeof(PackTrailer)))
+		return nullptr;
+
+	if (!io->seek(io, (PHYSFS_uint64) length - sizeof(PackTrailer)) || io->read(io, &trailer, sizeof(PackTrailer)) != sizeof(PackTrailer))
+		return nullptr;
+
+	if (memcmp(trailer.magic, PACK_TRAILER_MAGIC, sizeof(trailer.magic)) != 0)
+		return nullptr;
+
+	*claimed = 1;
+
+	// PhysFS reads through io, but we want the mapping. This only
+	// works for real files, not PHYSFS_mountMemory or PHYSFS_mountIo.
+	MappedFile *file = nullptr;
+
+	try
+	{
+		file = new MappedFile(name);
+	}
+	catch (love::Exception &)
+	{
+		PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+		return nullptr;
+	}
+
+	Archive *archive = new Archive(file, nullptr, name);
+	file->release();
+
+	if (!setupArchive(archive))
+	{
+		archive->release();
+		PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+		return nullptr;
+	}
+
+	// Only take ownership when succeeded
+	archive->io = io;
+
+	// The list doesn't hold a reference, closeArchive removes it.
+	love::thread::Lock lock(archivesMutex);
+	archives.push_back(archive);
+
+	return archive;
+}
+
+static PHYSFS_EnumerateCallbackResult enumerate(void *opaque, const char *dirname, PHYSFS_EnumerateCallback cb, const char *origdir, void *callbackdata)
+{
+	Archive *archive = (Archive *) opaque;
+	auto it = archive->directories.find(dirname);
+
+	if (it == archive->directories.end())
+		return PHYSFS_ENUM_OK;
+
+	for (const std::string &child: it->second)
+	{
+		PHYSFS_EnumerateCallbackResult result = cb(callbackdata, origdir, child.c_str());
+
+		if (result == PHYSFS_ENUM_ERROR)
+			PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
+		if (result != PHYSFS_ENUM_OK)
+			return result;
+	}
+
+	return PHYSFS_ENUM_OK;
+}
+
+static PHYSFS_Io *openRead(void *opaque, const char *filename)
+{
+	Archive *archive = (Archive *) opaque;
+	const PackEntry *entry = archive->find(filename);
+
+	if (entry == nullptr)
+	{
+		PHYSFS_setErrorCode(archive->directories.count(filename) ? PHYSFS_ERR_NOT_A_FILE : PHYSFS_ERR_NOT_FOUND);
+		return nullptr;
+	}
+
+	return newIo(archive, entry);
+}
+
+static PHYSFS_Io *openWrite(void *, const char *)
+{
+	PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+	return nullptr;
+}
+
+static int removeOrMkdir(void *, const char *)
+{
+	PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+	return 0;
+}
+
+static int archiveStat(void *opaque, const char *filename, PHYSFS_Stat *st)
+{
+	Archive *archive = (Archive *) opaque;
+	const PackEntry *entry = archive->find(filename);
+
+	st->modtime = st->createtime = st->accesstime = -1;
+	st->readonly = 1;
+
+	if (entry)
+	{
+		st->filesize = (PHYSFS_sint64) entry->size;
+		st->filetype = PHYSFS_FILETYPE_REGULAR;
+		return 1;
+	}
+	else if (archive->directories.count(filename))
+	{
+		st->filesize = 0;
+		st->filetype = PHYSFS_FILETYPE_DIRECTORY;
+		return 1;
+	}
+
+	PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+	return 0;
+}
+
+static void closeArchive(void *opaque)
+{
+	Archive *archive = (Archive *) opaque;
+
+	{
+		love::thread::Lock lock(archivesMutex);
+		archives.erase(std::remove(archives.begin(), archives.end(), archive), archives.end());
+	}
+
+	// Open files and MappedData keep the mapping alive
+	archive->release();
+}
+
+bool registerArchiver()
+{
+	static const PHYSFS_Archiver archiver = {
+		0,
+		{
+			"LSPK",
+			"livesim4 memory-mapped asset pack",
+			"Dark Energy Processor",
+			"",
+			0
+		},
+		openArchive,
+		enumerate,
+		openRead,
+		openWrite,
+		openWrite,
+		removeOrMkdir,
+		removeOrMkdir,
+		archiveStat,
+		closeArchive
+	};
+
+	return PHYSFS_registerArchiver(&archiver) != 0;
+}
+
+love::Data *getMappedData(const std::string &filename)
+{
+	const char *realDir = PHYSFS_getRealDir(filename.c_str());
+	if (realDir == nullptr)
+		return nullptr;
+
+	const char *mountPoint = PHYSFS_getMountPoint(realDir);
+	if (mountPoint == nullptr)
+		return nullptr;
+
+	// Path relative to the pack. Mount point always ends with slash.
+	std::string path = filename;
+	while (!path.empty() && path[0] == '/')
+		path.erase(0, 1);
+
+	std::string mount = mountPoint;
+	while (!mount.empty() && mount[0] == '/')
+		mount.erase(0, 1);
+
+	if (path.compare(0, mount.length(), mount) != 0)
+		return nullptr;
+
+	path.erase(0, mount.length());
+
+	love::thread::Lock lock(archivesMutex);
+
+	for (Archive *archive: archives)
+	{
+		if (archive->name != realDir)
+			continue;
+
+		const PackEntry *entry = archive->find(path);
+		if (entry == nullptr || entry->compression != PACK_STORED)
+			return nullptr;
+
+		return new MappedData(archive->file, archive->base + (size_t) entry->offset, (size_t) entry->size);
+	}
+
+	return nullptr;
+}
+
+} // pack
+} // livesim
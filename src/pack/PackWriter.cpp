@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// love
+#include "common/config.h"
+#include "libraries/lz4/lz4.h"
+#include "libraries/lz4/lz4hc.h"
+#include "libraries/physfs/physfs.h"
+#include "libraries/xxHash/xxhash.h"
+
+#ifdef LOVE_WINDOWS
+#include "common/utf8.h"
+#endif
+
+// Pack
+#include "Pack.h"
+
+namespace livesim
+{
+namespace pack
+{
+
+// Where the source directory is temporarily mounted
+static const char *const SOURCE_MOUNT = "/.livesim4-pack-source";
+
+static FILE *openOutput(const std::string &path)
+{
+	// Append to existing file (fused executable), otherwise create new one.
+#ifdef LOVE_WINDOWS
+	std::wstring wpath = love::to_widestr(path);
+	FILE *f = _wfopen(wpath.c_str(), L"r+b");
+	if (f == nullptr)
+		f = _wfopen(wpath.c_str(), L"w+b");
+#else
+	FILE *f = fopen(path.c_str(), "r+b");
+	if (f == nullptr)
+		f = fopen(path.c_str(), "w+b");
+#endif
+	return f;
+}
+
+static void listFiles(const std::string &dir, std::vector<std::string> &files)
+{
+	std::string mountDir = dir.empty() ? std::string(SOURCE_MOUNT) : std::string(SOURCE_MOUNT) + "/" + dir;
+	char **list = PHYSFS_enumerateFiles(mountDir.c_str());
+
+	if (list == nullptr)
+		return;
+
+	for (char **i = list; *i != nullptr; i++)
+	{
+		std::string name = dir.empty() ? std::string(*i) : dir + "/" + *i;
+		std::string fullName = std::string(SOURCE_MOUNT) + "/" + name;
+		PHYSFS_Stat st;
+
+		if (!PHYSFS_stat(fullName.c_str(), &st))
+			continue;
+
+		if (st.filetype == PHYSFS_FILETYPE_DIRECTORY)
+			listFiles(name, files);
+		else if (st.filetype == PHYSFS_FILETYPE_REGULAR)
+			files.push_back(name);
+	}
+
+	PHYSFS_freeList(list);
+}
+
+static bool readFile(const std::string &name, std::vector<char> &data)
+{
+	std::string fullName = std::string(SOURCE_MOUNT) + "/" + name;
+	PHYSFS_File *file = PHYSFS_openRead(fullName.c_str());
+
+	if (file == nullptr)
+		return false;
+
+	PHYSFS_sint64 length = PHYSFS_fileLength(file);
+	bool ok = length >= 0 && length <= LZ4_MAX_INPUT_SIZE;
+
+	if (ok)
+	{
+		data.resize((size_t) length);
+		ok = PHYSFS_readBytes(file, data.data(), (PHYSFS_uint64) length) == length;
+	}
+
+	PHYSFS_close(file);
+	return ok;
+}
+
+static bool pad(FILE *f, uint64_t pos, size_t alignment, uint64_t &padded)
+{
+	static const char zero[PACK_ALIGNMENT] = {0};
+	size_t amount = (size_t) ((alignment - pos % alignment) % alignment);
+
+	padded = pos + amount;
+	return amount == 0 || fwrite(zero, 1, amount, f) == amount;
+}
+
+static bool writePack(FILE *f, const std::vector<std::string> &files, bool compress)
+{
+	// Align pack start, so data alignment holds in memory too.
+	if (fseek(f, 0, SEEK_END) != 0)
+		return false;
+
+	long fileEnd = ftell(f);
+	uint64_t start = 0;
+	if (fileEnd < 0 || !pad(f, (uint64_t) fileEnd, PACK_ALIGNMENT, start))
+		return false;
+
+	// Header is written again at the end, once offsets are known
+	PackHeader header;
+	memset(&header, 0, sizeof(PackHeader));
+	memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+	header.version = PACK_VERSION;
+	header.fileCount = (uint32_t) files.size();
+
+	if (fwrite(&header, sizeof(PackHeader), 1, f) != 1)
+		return false;
+
+	std::vector<PackEntry> entries;
+	std::vector<char> data, packed;
+	uint64_t pos = sizeof(PackHeader);
+
+	for (const std::string &name: files)
+	{
+		if (!readFile(name, data))
+		{
+			fprintf(stderr, "Cannot read %s\n", name.c_str());
+			return false;
+		}
+
+		PackEntry e;
+		memset(&e, 0, sizeof(PackEntry));
+		e.hash = XXH64(name.data(), name.length(), 0);
+		e.size = data.size();
+		e.nameLength = (uint32_t) name.length();
+		e.compression = PACK_STORED;
+
+		const char *out = data.data();
+		size_t outSize = data.size();
+
+		if (compress && !data.empty())
+		{
+			packed.resize(LZ4_compressBound((int) data.size()));
+			int size = LZ4_compress_HC(data.data(), packed.data(), (int) data.size(), (int) packed.size(), LZ4HC_CLEVEL_MAX);
+
+			// Already compressed formats (PNG, OGG, ...) don't shrink. Keep
+			// them stored so they can be used straight from the mapping.
+			if (size > 0 && (uint64_t) size < data.size() - data.size() / 8)
+			{
+				e.compression = PACK_LZ4;
+				out = packed.data();
+				outSize = (size_t) size;
+			}
+		}
+
+		if (!pad(f, pos, PACK_ALIGNMENT, pos))
+			return false;
+
+		e.offset = pos;
+		e.packedSize = outSize;
+
+		if (outSize > 0 && fwrite(out, 1, outSize, f) != outSize)
+			return false;
+
+		pos += outSize;
+		entries.push_back(e);
+	}
+
+	// Sort index by hash for binary search, names follow the same order
+	std::vector<size_t> order(files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&entries, &files](size_t a, size_t b)
+	{
+		if (entries[a].hash != entries[b].hash)
+			return entries[a].hash < entries[b].hash;
+
+		return files[a] < files[b];
+	});
+
+	std::vector<PackEntry> index;
+	std::string names;
+
+	for (size_t i: order)
+	{
+		PackEntry e = entries[i];
+		e.nameOffset = (uint32_t) names.length();
+		names += files[i];
+		index.push_back(e);
+	}
+
+	if (!pad(f, pos, PACK_ALIGNMENT, pos))
+		return false;
+
+	header.indexOffset = pos;
+	if (!index.empty() && fwrite(index.data(), sizeof(PackEntry), index.size(), f) != index.size())
+		return false;
+
+	pos += index.size() * sizeof(PackEntry);
+	header.namesOffset = pos;
+	if (!names.empty() && fwrite(names.data(), 1, names.length(), f) != names.length())
+		return false;
+
+	pos += names.length();
+
+	PackTrailer trailer;
+	trailer.packSize = pos + sizeof(PackTrailer);
+	memcpy(trailer.magic, PACK_TRAILER_MAGIC, sizeof(trailer.magic));
+
+	if (fwrite(&trailer, sizeof(PackTrailer), 1, f) != 1)
+		return false;
+
+	// Now write the real header
+	return fseek(f, (long) start, SEEK_SET) == 0 && fwrite(&header, sizeof(PackHeader), 1, f) == 1;
+}
+
+bool packDirectory(const std::string &directory, const std::string &output, bool compress)
+{
+	if (!PHYSFS_mount(directory.c_str(), SOURCE_MOUNT, 0))
+	{
+		fprintf(stderr, "Cannot open %s: %s\n", directory.c_str(), PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+		return false;
+	}
+
+	std::vector<std::string> files;
+	listFiles("", files);
+
+	FILE *f = openOutput(output);
+	bool ok = f != nullptr && writePack(f, files, compress);
+
+	if (f)
+		ok = fclose(f) == 0 && ok;
+
+	PHYSFS_unmount(directory.c_str());
+
+	if (!ok)
+		fprintf(stderr, "Cannot write pack to %s\n", output.c_str());
+
+	return ok;
+}
+
+} // pack
+} // livesim
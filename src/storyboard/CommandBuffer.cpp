@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <algorithm>
+#include <cstring>
+
+// love
+#include "common/Module.h"
+#include "common/Matrix.h"
+
+// CommandBuffer
+#include "CommandBuffer.h"
+
+namespace livesim
+{
+namespace storyboard
+{
+
+CommandBuffer::CommandBuffer(size_t capacity, size_t textCapacity)
+	: commands(capacity)
+	, count(0)
+	, text(textCapacity)
+	, textSize(0)
+	, dropped(0)
+	, printText(1)
+{
+	printText[0].color = love::Colorf(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void CommandBuffer::clear()
+{
+	count = textSize = dropped = 0;
+}
+
+Command *CommandBuffer::add(Command::Type type)
+{
+	if (count >= commands.size())
+	{
+		dropped++;
+		return nullptr;
+	}
+
+	Command *cmd = &commands[count++];
+	cmd->type = type;
+	cmd->index = cmd->length = 0;
+	return cmd;
+}
+
+Command *CommandBuffer::addText(const char *str, size_t length)
+{
+	if (text.size() - textSize < length)
+	{
+		dropped++;
+		return nullptr;
+	}
+
+	Command *cmd = add(Command::PRINT);
+	if (cmd == nullptr)
+		return nullptr;
+
+	if (length > 0)
+		memcpy(&text[textSize], str, length);
+
+	cmd->index = (uint32_t) textSize;
+	cmd->length = (uint32_t) length;
+	textSize += length;
+	return cmd;
+}
+
+size_t CommandBuffer::size() const
+{
+	return count;
+}
+
+size_t CommandBuffer::getDropped() const
+{
+	return dropped;
+}
+
+void CommandBuffer::execute(const std::vector<asset::AsyncImage *> &images) const
+{
+	using love::graphics::Graphics;
+
+	auto gfx = love::Module::getInstance<Graphics>(love::Module::M_GRAPHICS);
+	if (gfx == nullptr || count == 0)
+		return;
+
+	love::Colorf color = gfx->getColor();
+	int depth = 0;
+	// Pushes past MAX_DEPTH, which are not done
+	int ignored = 0;
+
+	gfx->push();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Command &cmd = commands[i];
+		const float *a = cmd.args;
+
+		switch (cmd.type)
+		{
+		case Command::DRAW:
+			if (cmd.index < images.size() && images[cmd.index]->isReady())
+				gfx->draw(images[cmd.index]->get(), love::Matrix4(a[0], a[1], a[2], a[3], a[4], a[5], a[6], 0.0f, 0.0f));
+			break;
+		case Command::RECTANGLE:
+			gfx->rectangle(cmd.index ? Graphics::DRAW_FILL : Graphics::DRAW_LINE, a[0], a[1], a[2], a[3]);
+			break;
+		case Command::PRINT:
+			printText[0].str.assign(text.data() + cmd.index, cmd.length);
+			gfx->print(printText, love::Matrix4(a[0], a[1], a[2], a[3], a[4], 0.0f, 0.0f, 0.0f, 0.0f));
+			break;
+		case Command::SET_COLOR:
+			gfx->setColor(love::Colorf(a[0], a[1], a[2], a[3]));
+			break;
+		case Command::PUSH:
+			if (depth < MAX_DEPTH)
+			{
+				gfx->push();
+				depth++;
+			}
+			else
+				ignored++;
+			break;
+		case Command::POP:
+			// Never pop past the storyboard's own push.
+			if (ignored > 0)
+				ignored--;
+			else if (depth > 0)
+			{
+				gfx->pop();
+				depth--;
+			}
+			break;
+		case Command::TRANSLATE:
+			gfx->translate(a[0], a[1]);
+			break;
+		case Command::ROTATE:
+			gfx->rotate(a[0]);
+			break;
+		case Command::SCALE:
+			gfx->scale(a[0], a[1]);
+			break;
+		}
+	}
+
+	for (; depth > 0; depth--)
+		gfx->pop();
+
+	gfx->pop();
+	gfx->setColor(color);
+}
+
+void CommandBuffer::swap(CommandBuffer &other)
+{
+	commands.swap(other.commands);
+	text.swap(other.text);
+	std::swap(count, other.count);
+	std::swap(textSize, other.textSize);
+	std::swap(dropped, other.dropped);
+}
+
+} // storyboard
+} // livesim
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_STORYBOARD_COMMANDBUFFER_H
+#define LIVESIM_STORYBOARD_COMMANDBUFFER_H
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// love
+#include "modules/graphics/Graphics.h"
+
+// Asset manager
+#include "../AssetManager.h"
+
+namespace livesim
+{
+namespace storyboard
+{
+
+/* Single draw command, plain data so the buffer can be reused. */
+struct Command
+{
+	enum Type
+	{
+		DRAW = 0,
+		RECTANGLE,
+		PRINT,
+		SET_COLOR,
+		PUSH,
+		POP,
+		TRANSLATE,
+		ROTATE,
+		SCALE
+	};
+
+	Type type;
+	// Image index for DRAW, 1 if filled for RECTANGLE, text offset for PRINT
+	uint32_t index;
+	// Text length for PRINT
+	uint32_t length;
+	float args[7];
+};
+
+/*
+ * Fixed-capacity list of draw commands. Storage is allocated once, and
+ * commands which don't fit are dropped instead of growing the buffer.
+ */
+class CommandBuffer
+{
+public:
+	/**
+	 * Create command buffer.
+	 *
+	 * @param capacity Maximum amount of commands.
+	 * @param textCapacity Maximum amount of text bytes for PRINT commands.
+	 */
+	CommandBuffer(size_t capacity = 4096, size_t textCapacity = 65536);
+	void clear();
+	/**
+	 * Append command. Only its type is set.
+	 *
+	 * @param type Command type.
+	 * @return Pointer to the command, or nullptr if the buffer is full.
+	 */
+	Command *add(Command::Type type);
+	/**
+	 * Append PRINT command and copy its text.
+	 *
+	 * @return Pointer to the command, or nullptr if the buffer is full.
+	 */
+	Command *addText(const char *str, size_t length);
+	size_t size() const;
+	/**
+	 * Get amount of commands dropped since last clear().
+	 *
+	 * @return Dropped command count.
+	 */
+	size_t getDropped() const;
+	/**
+	 * Run the commands with love.graphics. Transform stack and color are
+	 * restored afterwards, even if pushes and pops are unbalanced. Pushes
+	 * deeper than MAX_DEPTH are ignored, along with their pops.
+	 *
+	 * @param images Images referenced by DRAW commands. DRAW commands of
+	 *               images which aren't loaded yet are skipped.
+	 */
+	void execute(const std::vector<asset::AsyncImage *> &images) const;
+	void swap(CommandBuffer &other);
+
+	// Well below love.graphics stack limit, which the scene shares.
+	static const int MAX_DEPTH = 32;
+
+private:
+	std::vector<Command> commands;
+	size_t count;
+	std::vector<char> text;
+	size_t textSize;
+	size_t dropped;
+	// Reused by PRINT, so its string keeps the capacity between frames.
+	mutable std::vector<love::graphics::Font::ColoredString> printText;
+};
+
+} // storyboard
+} // livesim
+
+#endif
@@ -0,0 +1,584 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+// std
+#include <cstdio>
+#include <cstring>
+
+// Lua
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+#include "luajit.h"
+}
+
+// love
+#include "common/Exception.h"
+#include "common/Module.h"
+#include "modules/filesystem/Filesystem.h"
+#include "modules/timer/Timer.h"
+#include "libraries/xxHash/xxhash.h"
+
+// Asset manager
+#include "../AssetManager.h"
+
+// Beatmap cache
+#include "../beatmap/BeatmapCache.h"
+
+// Storyboard
+#include "Storyboard.h"
+
+namespace livesim
+{
+namespace storyboard
+{
+
+namespace
+{
+
+// Instructions between budget checks
+const int HOOK_INTERVAL = 1000;
+// Distinct images a storyboard can load
+const size_t MAX_IMAGES = 256;
+
+// Only one storyboard runs at a time, on the main thread.
+Storyboard *current = nullptr;
+
+inline float optFloat(lua_State *L, int idx, float def)
+{
+	return (float) luaL_optnumber(L, idx, def);
+}
+
+void openLibrary(lua_State *L, lua_CFunction func, const char *name)
+{
+	lua_pushcfunction(L, func);
+	lua_pushstring(L, name);
+	lua_call(L, 1, 0);
+}
+
+/*
+ * Bytecode cache file is BytecodeHeader followed by the bytecode. LuaJIT
+ * doesn't verify bytecode, so it's only loaded if the hash matches.
+ */
+const char BYTECODE_MAGIC[4] = {'L', 'S', 'B', 'X'};
+const uint32_t BYTECODE_VERSION = 1;
+
+#ifdef _DEBUG
+const bool STRIP_BYTECODE = false;
+#else
+const bool STRIP_BYTECODE = true;
+#endif
+
+struct BytecodeHeader
+{
+	char magic[4];
+	uint32_t version;
+	// XXH64 of the bytecode, seed 0
+	uint64_t contentHash;
+};
+
+// Bytecode depends on Lua version, pointer size and stripping.
+uint64_t getBytecodeKey(const std::string &script)
+{
+	char version[64];
+	sprintf(version, "%s %d %d", LUAJIT_VERSION, (int) sizeof(void *), STRIP_BYTECODE ? 1 : 0);
+
+	uint64_t seed = XXH64(version, strlen(version), 0);
+	return XXH64(script.data(), script.length(), seed);
+}
+
+std::string getBytecodeName(uint64_t key)
+{
+	char name[64];
+	sprintf(name, "%s/%016llx.lsbx", beatmap::CACHE_DIRECTORY, (unsigned long long) key);
+	return name;
+}
+
+love::filesystem::Filesystem *getFilesystem()
+{
+	auto fs = love::Module::getInstance<love::filesystem::Filesystem>(love::Module::M_FILESYSTEM);
+
+	if (fs == nullptr || *fs->getSaveDirectory() == 0)
+		return nullptr;
+
+	return fs;
+}
+
+love::filesystem::FileData *readBytecode(uint64_t key)
+{
+	auto fs = getFilesystem();
+	if (fs == nullptr)
+		return nullptr;
+
+	love::filesystem::FileData *data = nullptr;
+	try
+	{
+		data = fs->read(getBytecodeName(key).c_str());
+	}
+	catch (love::Exception &)
+	{
+		return nullptr;
+	}
+
+	const uint8_t *ptr = (const uint8_t *) data->getData();
+	size_t size = data->getSize();
+	BytecodeHeader header;
+
+	if (size > sizeof(BytecodeHeader))
+	{
+		memcpy(&header, ptr, sizeof(BytecodeHeader));
+
+		if (memcmp(header.magic, BYTECODE_MAGIC, 4) == 0 && header.version == BYTECODE_VERSION &&
+			XXH64(ptr + sizeof(BytecodeHeader), size - sizeof(BytecodeHeader), 0) == header.contentHash)
+			return data;
+	}
+
+	data->release();
+	return nullptr;
+}
+
+void writeBytecode(uint64_t key, const char *bytecode, size_t size)
+{
+	auto fs = getFilesystem();
+	if (fs == nullptr)
+		return;
+
+	std::vector<char> buffer(sizeof(BytecodeHeader) + size);
+	BytecodeHeader header;
+
+	memcpy(header.magic, BYTECODE_MAGIC, 4);
+	header.version = BYTECODE_VERSION;
+	header.contentHash = XXH64(bytecode, size, 0);
+	memcpy(&buffer[0], &header, sizeof(BytecodeHeader));
+	memcpy(&buffer[sizeof(BytecodeHeader)], bytecode, size);
+
+	try
+	{
+		fs->createDirectory(beatmap::CACHE_DIRECTORY);
+		fs->write(getBytecodeName(key).c_str(), buffer.data(), (love::int64) buffer.size());
+	}
+	catch (love::Exception &) {}
+}
+
+} // anonymous
+
+Storyboard::Storyboard(const std::string &script, const std::string &name)
+	: L(luaL_newstate())
+	, thread(nullptr)
+	, loaded(false)
+	, running(false)
+	, budgetTime(0.002)
+	, budgetInstructions(0)
+	, deadline(0.0)
+	, instructionsLeft(0)
+	, yieldPending(false)
+{
+	if (L == nullptr)
+		throw love::Exception("Could not create storyboard Lua state");
+
+	// Hooks only fire in the interpreter.
+	luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+
+	// No io, os, package, nor debug
+	openLibrary(L, luaopen_base, "");
+	openLibrary(L, luaopen_table, LUA_TABLIBNAME);
+	openLibrary(L, luaopen_string, LUA_STRLIBNAME);
+	openLibrary(L, luaopen_math, LUA_MATHLIBNAME);
+	openLibrary(L, luaopen_bit, LUA_BITLIBNAME);
+
+	static const char *unsafe[] = {"dofile", "loadfile", "load", "loadstring", "collectgarbage", "getfenv", "setfenv", nullptr};
+	for (const char **f = unsafe; *f; f++)
+	{
+		lua_pushnil(L);
+		lua_setglobal(L, *f);
+	}
+
+	static const luaL_Reg functions[] = {
+		{"loadImage", w_loadImage},
+		{"draw", w_draw},
+		{"rectangle", w_rectangle},
+		{"print", w_print},
+		{"setColor", w_setColor},
+		{"push", w_push},
+		{"pop", w_pop},
+		{"translate", w_translate},
+		{"rotate", w_rotate},
+		{"scale", w_scale},
+		{nullptr, nullptr}
+	};
+
+	// Functions get the storyboard as upvalue, so no userdata is involved.
+	lua_newtable(L);
+	for (const luaL_Reg *r = functions; r->name; r++)
+	{
+		lua_pushlightuserdata(L, this);
+		lua_pushcclosure(L, r->func, 1);
+		lua_setfield(L, -2, r->name);
+	}
+	lua_setglobal(L, "storyboard");
+
+	try
+	{
+		loadScript(script, name);
+	}
+	catch (love::Exception &)
+	{
+		lua_close(L);
+		throw;
+	}
+
+	// Keep the thread referenced by the main state's stack.
+	thread = lua_newthread(L);
+	lua_insert(L, -2);
+	lua_xmove(L, thread, 1);
+}
+
+Storyboard::~Storyboard()
+{
+	lua_close(L);
+
+	for (asset::AsyncImage *img: images)
+		img->release();
+}
+
+void Storyboard::loadScript(const std::string &script, const std::string &name)
+{
+	std::string chunkname = "@" + name;
+	uint64_t key = getBytecodeKey(script);
+	love::StrongRef<love::filesystem::FileData> cached(readBytecode(key), love::Acquire::NORETAIN);
+
+	if (cached.get())
+	{
+		const char *bytecode = (const char *) cached->getData() + sizeof(BytecodeHeader);
+		size_t size = cached->getSize() - sizeof(BytecodeHeader);
+
+		if (luaL_loadbufferx(L, bytecode, size, chunkname.c_str(), "b") == 0)
+			return;
+
+		lua_pop(L, 1);
+	}
+
+	// Scripts from beatmaps must never be loaded as bytecode.
+	if (luaL_loadbufferx(L, script.data(), script.length(), chunkname.c_str(), "t") != 0)
+	{
+		std::string msg = lua_tostring(L, -1);
+		throw love::Exception("%s", msg.c_str());
+	}
+
+	// string.dump can strip debug info, unlike lua_dump.
+	lua_getglobal(L, "string");
+	lua_getfield(L, -1, "dump");
+	lua_pushvalue(L, -3);
+	lua_pushboolean(L, STRIP_BYTECODE ? 1 : 0);
+
+	if (lua_pcall(L, 2, 1, 0) == 0)
+	{
+		size_t size;
+		const char *bytecode = lua_tolstring(L, -1, &size);
+		if (bytecode)
+			writeBytecode(key, bytecode, size);
+	}
+
+	// Leave only the compiled chunk.
+	lua_pop(L, 2);
+}
+
+void Storyboard::setBudget(double seconds, int instructions)
+{
+	budgetTime = seconds;
+	budgetInstructions = instructions;
+}
+
+bool Storyboard::update(double time, double deltaT)
+{
+	if (!error.empty())
+		return false;
+
+	int nargs = 0;
+
+	if (!running)
+	{
+		// The chunk is already on the thread stack for the first run.
+		if (loaded)
+		{
+			lua_getglobal(thread, "update");
+			if (!lua_isfunction(thread, -1))
+			{
+				lua_pop(thread, 1);
+				return true;
+			}
+
+			lua_pushnumber(thread, time);
+			lua_pushnumber(thread, deltaT);
+			nargs = 2;
+		}
+
+		back.clear();
+	}
+
+	deadline = love::timer::Timer::getTime() + budgetTime;
+	instructionsLeft = budgetInstructions;
+	yieldPending = false;
+	current = this;
+	lua_sethook(thread, budgetHook, LUA_MASKCOUNT, HOOK_INTERVAL);
+
+	int status = lua_resume(thread, nargs);
+
+	lua_sethook(thread, nullptr, 0, 0);
+	current = nullptr;
+
+	if (status == LUA_YIELD)
+	{
+		// Out of budget, or the script yielded on purpose.
+		running = true;
+		return true;
+	}
+	else if (status != 0)
+	{
+		const char *msg = lua_tostring(thread, -1);
+		error = msg ? msg : "unknown storyboard error";
+		running = false;
+		return false;
+	}
+
+	lua_settop(thread, 0);
+	running = false;
+	loaded = true;
+	front.swap(back);
+	return true;
+}
+
+void Storyboard::draw()
+{
+	front.execute(images);
+}
+
+const std::string &Storyboard::getError() const
+{
+	return error;
+}
+
+void Storyboard::budgetHook(lua_State *L, lua_Debug *)
+{
+	Storyboard *self = current;
+	if (self == nullptr)
+		return;
+
+	bool exhausted = love::timer::Timer::getTime() >= self->deadline;
+	if (self->budgetInstructions > 0)
+	{
+		self->instructionsLeft -= HOOK_INTERVAL;
+		exhausted = exhausted || self->instructionsLeft <= 0;
+	}
+
+	if (exhausted)
+		self->yieldPending = true;
+
+	// Hooks are global, so this may run in the script's own coroutines,
+	// or in Lua called back from C, where yielding is an error. Yield at
+	// the next hook in the storyboard thread instead.
+	if (self->yieldPending && L == self->thread && !isInCFunction(L))
+	{
+		self->yieldPending = false;
+		lua_yield(L, 0);
+	}
+}
+
+bool Storyboard::isInCFunction(lua_State *L)
+{
+	lua_Debug ar;
+
+	for (int level = 0; lua_getstack(L, level, &ar); level++)
+	{
+		lua_getinfo(L, "S", &ar);
+		if (strcmp(ar.what, "C") == 0)
+			return true;
+	}
+
+	return false;
+}
+
+Storyboard *Storyboard::getSelf(lua_State *L)
+{
+	return (Storyboard *) lua_touserdata(L, lua_upvalueindex(1));
+}
+
+int Storyboard::w_loadImage(lua_State *L)
+{
+	Storyboard *self = getSelf(L);
+	std::string filename = luaL_checkstring(L, 1);
+	asset::AsyncImage *img = nullptr;
+
+	auto it = self->imageIndices.find(filename);
+	if (it != self->imageIndices.end())
+	{
+		lua_pushinteger(L, (lua_Integer) it->second + 1);
+		return 1;
+	}
+
+	if (self->images.size() >= MAX_IMAGES)
+		return luaL_error(L, "Too many images, at most %d can be loaded", (int) MAX_IMAGES);
+
+	// Loading in the middle of a budgeted update would stall the frame.
+	// Until it's loaded, or if it fails, drawing it does nothing.
+	try
+	{
+		img = asset::loadImageAsync(filename);
+	}
+	catch (love::Exception &e)
+	{
+		return luaL_error(L, "%s", e.what());
+	}
+
+	self->imageIndices[filename] = self->images.size();
+	self->images.push_back(img);
+	lua_pushinteger(L, (lua_Integer) self->images.size());
+	return 1;
+}
+
+int Storyboard::w_draw(lua_State *L)
+{
+	Storyboard *self = getSelf(L);
+	int index = (int) luaL_checkinteger(L, 1);
+
+	if (index < 1 || index > (int) self->images.size())
+		return luaL_argerror(L, 1, "invalid image");
+
+	Command *cmd = self->back.add(Command::DRAW);
+	if (cmd)
+	{
+		cmd->index = (uint32_t) (index - 1);
+		cmd->args[0] = optFloat(L, 2, 0.0f);
+		cmd->args[1] = optFloat(L, 3, 0.0f);
+		cmd->args[2] = optFloat(L, 4, 0.0f);
+		cmd->args[3] = optFloat(L, 5, 1.0f);
+		cmd->args[4] = optFloat(L, 6, cmd->args[3]);
+		cmd->args[5] = optFloat(L, 7, 0.0f);
+		cmd->args[6] = optFloat(L, 8, 0.0f);
+	}
+
+	return 0;
+}
+
+int Storyboard::w_rectangle(lua_State *L)
+{
+	Storyboard *self = getSelf(L);
+	const char *mode = luaL_checkstring(L, 1);
+	bool fill = strcmp(mode, "fill") == 0;
+
+	if (!fill && strcmp(mode, "line") != 0)
+		return luaL_argerror(L, 1, "expected \"fill\" or \"line\"");
+
+	Command *cmd = self->back.add(Command::RECTANGLE);
+	if (cmd)
+	{
+		cmd->index = fill ? 1 : 0;
+		for (int i = 0; i < 4; i++)
+			cmd->args[i] = (float) luaL_checknumber(L, i + 2);
+	}
+
+	return 0;
+}
+
+int Storyboard::w_print(lua_State *L)
+{
+	Storyboard *self = getSelf(L);
+	size_t len;
+	const char *text = luaL_checklstring(L, 1, &len);
+
+	Command *cmd = self->back.addText(text, len);
+	if (cmd)
+	{
+		cmd->args[0] = optFloat(L, 2, 0.0f);
+		cmd->args[1] = optFloat(L, 3, 0.0f);
+		cmd->args[2] = optFloat(L, 4, 0.0f);
+		cmd->args[3] = optFloat(L, 5, 1.0f);
+		cmd->args[4] = optFloat(L, 6, cmd->args[3]);
+	}
+
+	return 0;
+}
+
+int Storyboard::w_setColor(lua_State *L)
+{
+	Storyboard *self = getSelf(L);
+	Command *cmd = self->back.add(Command::SET_COLOR);
+
+	if (cmd)
+	{
+		for (int i = 0; i < 3; i++)
+			cmd->args[i] = (float) luaL_checknumber(L, i + 1);
+		cmd->args[3] = optFloat(L, 4, 1.0f);
+	}
+
+	return 0;
+}
+
+int Storyboard::w_push(lua_State *L)
+{
+	getSelf(L)->back.add(Command::PUSH);
+	return 0;
+}
+
+int Storyboard::w_pop(lua_State *L)
+{
+	getSelf(L)->back.add(Command::POP);
+	return 0;
+}
+
+int Storyboard::w_translate(lua_State *L)
+{
+	Command *cmd = getSelf(L)->back.add(Command::TRANSLATE);
+
+	if (cmd)
+	{
+		cmd->args[0] = (float) luaL_checknumber(L, 1);
+		cmd->args[1] = (float) luaL_checknumber(L, 2);
+	}
+
+	return 0;
+}
+
+int Storyboard::w_rotate(lua_State *L)
+{
+	Command *cmd = getSelf(L)->back.add(Command::ROTATE);
+
+	if (cmd)
+		cmd->args[0] = (float) luaL_checknumber(L, 1);
+
+	return 0;
+}
+
+int Storyboard::w_scale(lua_State *L)
+{
+	Command *cmd = getSelf(L)->back.add(Command::SCALE);
+
+	if (cmd)
+	{
+		cmd->args[0] = (float) luaL_checknumber(L, 1);
+		cmd->args[1] = optFloat(L, 2, cmd->args[0]);
+	}
+
+	return 0;
+}
+
+} // storyboard
+} // livesim
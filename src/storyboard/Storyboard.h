@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2039 Dark Energy Processor
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef LIVESIM_STORYBOARD_STORYBOARD_H
+#define LIVESIM_STORYBOARD_STORYBOARD_H
+
+// std
+#include <map>
+#include <string>
+#include <vector>
+
+// love
+#include "common/Object.h"
+#include "modules/graphics/Image.h"
+
+// CommandBuffer
+#include "CommandBuffer.h"
+
+struct lua_State;
+struct lua_Debug;
+
+namespace livesim
+{
+namespace storyboard
+{
+
+/*
+ * Storyboard script running in its own lua_State, isolated from the game
+ * state. The script runs once when loaded, and its global update(time, dt)
+ * function, if any, is called by update(). Both run in a coroutine, and a
+ * count hook yields it once the per-frame budget runs out, so the rest
+ * runs on the next frames.
+ *
+ * Drawing functions in the "storyboard" table only append to a command
+ * buffer. Once an update call finishes, its commands become the ones drawn
+ * by draw().
+ */
+class Storyboard: public love::Object
+{
+public:
+	/**
+	 * Load storyboard script. Nothing is run until update().
+	 *
+	 * Compiled script is cached as bytecode in the beatmap cache directory,
+	 * keyed by the script and Lua version, and stripped of debug info in
+	 * release builds. Later loads of the same script skip the compiler.
+	 *
+	 * @param script Lua source code, e.g. from FiLiveBeatmap::getStoryboard.
+	 * @param name Chunk name used in error messages.
+	 * @throws love::Exception if the script has syntax error.
+	 */
+	Storyboard(const std::string &script, const std::string &name = "storyboard");
+	virtual ~Storyboard();
+	/**
+	 * Set per-update budget.
+	 *
+	 * @param seconds Maximum time spent running the script.
+	 * @param instructions Maximum amount of Lua instructions, 0 for no limit.
+	 */
+	void setBudget(double seconds, int instructions = 0);
+	/**
+	 * Run the storyboard until the current update call finishes or the
+	 * budget runs out. An update call interrupted by the budget is resumed
+	 * next time, with its original time.
+	 *
+	 * @param time Song position in seconds.
+	 * @param deltaT Time since last update.
+	 * @return false if the storyboard stopped due to error.
+	 */
+	bool update(double time, double deltaT);
+	/* Draw the commands of the last finished update call. */
+	void draw();
+	/**
+	 * Get error message of the storyboard.
+	 *
+	 * @return Error message, or empty string if there's no error.
+	 */
+	const std::string &getError() const;
+
+private:
+	static int w_loadImage(lua_State *L);
+	static int w_draw(lua_State *L);
+	static int w_rectangle(lua_State *L);
+	static int w_print(lua_State *L);
+	static int w_setColor(lua_State *L);
+	static int w_push(lua_State *L);
+	static int w_pop(lua_State *L);
+	static int w_translate(lua_State *L);
+	static int w_rotate(lua_State *L);
+	static int w_scale(lua_State *L);
+	static void budgetHook(lua_State *L, lua_Debug *ar);
+	static bool isInCFunction(lua_State *L);
+
+	static Storyboard *getSelf(lua_State *L);
+
+	void loadScript(const std::string &script, const std::string &name);
+
+	lua_State *L;
+	lua_State *thread;
+	bool loaded;
+	bool running;
+	std::string error;
+
+	double budgetTime;
+	int budgetInstructions;
+	double deadline;
+	int instructionsLeft;
+	// Budget ran out, but the hook couldn't yield there
+	bool yieldPending;
+
+	std::vector<asset::AsyncImage *> images;
+	// Index in images by filename, so reloading an image reuses it.
+	std::map<std::string, size_t> imageIndices;
+	CommandBuffer front;
+	CommandBuffer back;
+};
+
+} // storyboard
+} // livesim
+
+#endif